@@ -0,0 +1,65 @@
+#ifdef ARDUINO
+
+#include "RedisCC3000Transport.h"
+
+RedisCC3000Transport::RedisCC3000Transport() {
+   _cc3000 = NULL;
+}
+
+// cc3000 - Adafruit_CC3000 library object to use
+
+RedisCC3000Transport::RedisCC3000Transport(Adafruit_CC3000* cc3000) {
+   _cc3000 = cc3000;
+}
+
+void RedisCC3000Transport::setNetwork(Adafruit_CC3000* cc3000) {
+   _cc3000 = cc3000;
+}
+
+bool RedisCC3000Transport::connect(uint32_t ip, uint16_t port) {
+    if (_cc3000 == NULL)
+      return false;
+
+    _client = _cc3000->connectTCP(ip, port);
+
+    if (!_client.connected()) {
+        _client.close();
+        return false;
+    }
+    return true;
+}
+
+bool RedisCC3000Transport::connected() {
+    return _client.connected();
+}
+
+void RedisCC3000Transport::close() {
+    _client.close();
+}
+
+int RedisCC3000Transport::write(const uint8_t *buf, uint16_t len) {
+    int16_t rc = _client.write(buf, len);
+    return rc < 0 ? -1 : rc;
+}
+
+int RedisCC3000Transport::available() {
+    return _client.available();
+}
+
+int RedisCC3000Transport::read() {
+    if (!_client.available())
+      return -1;
+    return _client.read();
+}
+
+int RedisCC3000Transport::read(uint8_t *buf, uint16_t len) {
+    int avail = _client.available();
+    if (avail <= 0)
+      return 0;
+    if (len > avail)
+      len = avail;
+    int rc = _client.read(buf, len);
+    return rc < 0 ? 0 : rc;
+}
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef H_REDIS_CC3000_TRANSPORT
+#define H_REDIS_CC3000_TRANSPORT
+
+#ifdef ARDUINO
+
+#include <Adafruit_CC3000.h>
+#include <ccspi.h>
+#include <SPI.h>
+
+#include "RedisTransport.h"
+
+//
+// RedisTransport on top of the Adafruit CC3000 WiFi breakout.
+//
+
+class RedisCC3000Transport : public RedisTransport {
+private:
+    Adafruit_CC3000* _cc3000;                                 // The network object
+    Adafruit_CC3000_Client _client;                           // the network client object
+
+public:
+    RedisCC3000Transport();
+    RedisCC3000Transport(Adafruit_CC3000* cc3000);
+    void setNetwork(Adafruit_CC3000* cc3000);
+
+    bool connect(uint32_t ip, uint16_t port);
+    bool connected();
+    void close();
+
+    int write(const uint8_t *buf, uint16_t len);
+    int available();
+    int read();
+    int read(uint8_t *buf, uint16_t len);
+};
+
+#endif
+
+#endif
@@ -26,6 +26,9 @@
 // to hold the results of the INCR. So now create a char buffer 32 bytes long.,then you call client->INCR("bignum",buffer,32);
 // Buffer will hold the returned value ""
 //
+// Or take the number as it is: every integer reply is read in full 64 bits. After the INCR,
+// client->integerOverflowed() is true and client->lastInteger() returns 4444556667757 as an int64_t.
+//
 //
 // 
 // Note-1, this is a subset of the REDIS commands implemented here.
@@ -40,51 +43,103 @@
 //
 // long RedisClient::INCR(char* key) {
 //    connect();
-//    startCmd(2);
-//    addArg("INCR");
-//   addArg(key);
+//    startCmd(2, RedisCmd_INCR);
+//    addArg(key);
 //
-//   _client.write(cmdBuf,strlen(cmdBuf));
-//   return resultInt();
+//   if (!sendCmd())
+//     return 0;
+//   return readInt();
 // }
 //
-// Copy this method, and change the method to LLEN, chNGE addArg("INCR") to addArg("LLEN"), add the
-// prototype to the RedisClient.h file and voila! Now you can determine the number of items in a list.
+// Copy this method, and change the method to LLEN, change RedisCmd_INCR to RedisCmd_LLEN, add
+// X(LLEN, 4) to the table in RedisCommands.h, add the prototype to the RedisClient.h file and
+// voila! Now you can determine the number of items in a list.
 //
 
 #define CRLF  "\r\n"
 
 // Empty Constructor
 RedisClient::RedisClient() {
-   _client = NULL;
+   _transport = NULL;
    isConnected = 0;
 }
 
+// Constructor:
+// ip - The IP address of the REDIS host
+// port - The port of the REDIS host
+// transport - the network layer to talk to REDIS through, e.g. a RedisPosixTransport
+
+RedisClient::RedisClient(uint32_t ip, uint16_t port, RedisTransport* transport) {
+   this->_transport = transport;
+   this->ip = ip;
+   this->port = port;
+}
+
+#ifdef ARDUINO
+
 // Constructor:
 // ip - The IP address of the REDIS host
 // port - The port of the REDIS host
 // cc3000 - Adafruit_CC3000 library object to use
 
 RedisClient::RedisClient(uint32_t ip, uint16_t port, Adafruit_CC3000* cc3000) {
-   this->_cc3000 = cc3000;
+   _cc3000Transport.setNetwork(cc3000);
+   this->_transport = &_cc3000Transport;
    this->ip = ip;
    this->port = port;
 }
 
+#endif
 
-// CONNECT, all REDIS commands will attempt a connect first.
+
+// CONNECT, all REDIS commands will attempt a connect first. A connection that was closed
+// under us is noticed here and opened again. After a failed attempt the next one waits
+// for a backoff delay, doubling from REDIS_RETRY_MIN to REDIS_RETRY_MAX; until then
+// connect() fails at once rather than stall the sketch in the network stack again.
 
 bool RedisClient::connect() {
-      if (isConnected)
-        return true;
+      _keep = true;
+      if (isConnected) {
+        if (_transport->connected())
+          return true;
+        // A command armed by async() goes out on the new connection, or fails in sendCmd().
+        bool armed = _asyncArmed;
+        drop();
+        _asyncArmed = armed;
+      }
 
-      _client = _cc3000->connectTCP(this->ip, this->port);
+      if (_transport == NULL || (_retryWait && millis() - _retryAt < _retryWait))
+          return false;
 
-      if (!_client.connected()) {
-          _client.close();
+      if (!_transport->connect(this->ip, this->port)) {
+#if REDIS_STATS
+          _stats.connectFailures++;
+#endif
+          _retryAt = millis();
+          _retryDelay = _retryDelay == 0 ? _retryMin : _retryDelay < _retryMax / 2 ? _retryDelay * 2 : _retryMax;
+          // Up to a quarter off, so devices that lost the same access point don't all come back at once.
+          _retryWait = _retryDelay - micros() % (_retryDelay / 4 + 1);
+          notify(RedisConnection_RETRY, _retryWait);
           return false;
       }
+
       isConnected = 1;
+#if REDIS_STATS
+      _stats.connects++;
+#endif
+      _retryDelay = 0;
+      _retryWait = 0;
+      _lastTraffic = millis();
+      if (_protocol == 3)
+        hello();
+      if (_cacheOwner)
+        _clientId = clientId();                                 // before subscribing, it can't be asked after
+      resubscribe();
+      if (isConnected)
+        sendQueue();
+      if (!isConnected)
+        return false;
+      notify(RedisConnection_UP, 0);
       return true;
 }
 
@@ -95,30 +150,131 @@ bool RedisClient::connect(uint32_t ip, uint16_t port) {
   disconnect();
   this->ip = ip;
   this->port = port;
+  _retryDelay = 0;
+  _retryWait = 0;
   return connect();
   
 }
 
-// Disconnect from the currently connected REDIS.
+bool RedisClient::connected() {
+  return isConnected && _transport->connected();
+}
+
+// Set the function told when the connection comes up, goes down, or a connect fails.
+
+void RedisClient::onConnection(RedisConnectionCallback callback, void* ctx) {
+    _onConnection = callback;
+    _onConnectionCtx = ctx;
+}
+
+void RedisClient::notify(RedisConnectionState state, uint32_t retry_ms) {
+    if (_onConnection)
+      _onConnection(_onConnectionCtx, state, retry_ms);
+}
+
+// A reply that keeps silent for timeout_ms means the connection is dead: a WiFi link that
+// is gone doesn't close the TCP connection, it just stops delivering. 0 waits forever.
+
+void RedisClient::setReplyTimeout(uint32_t timeout_ms) {
+    _replyTimeout = timeout_ms;
+}
+
+// Wait min_ms after a failed connect before trying again, twice as long after each
+// further failure, but never more than max_ms.
+
+void RedisClient::setRetry(uint32_t min_ms, uint32_t max_ms) {
+    _retryMin = min_ms;
+    _retryMax = max_ms;
+}
+
+// Have poll() send a PING when nothing went over the connection for idle_ms, so a dead
+// connection is found (and replaced) while the sketch is idle, not by the next command.
+// The answer must come within the reply timeout.
+
+void RedisClient::setKeepAlive(uint32_t idle_ms) {
+    _keepAlive = idle_ms;
+}
+
+long RedisClient::PING() {
+    connect();
+    startCmd(1, RedisCmd_PING);
+    if (!sendCmd())
+      return 0;
+    return resultType() == RedisResult_SINGLELINE;
+}
+
+// Switch the connection to RESP3 (protocol 3) or back to RESP2 (protocol 2) with HELLO.
+// RESP3 has typed replies (maps, doubles, booleans...) and sends Pub/Sub messages and cache
+// invalidations as push frames, so one connection can carry all of them. REDIS older than
+// 6.0 doesn't know HELLO and stays at RESP2. Returns true if the server switched; it is
+// asked again after every reconnect.
+
+bool RedisClient::HELLO(uint8_t protocol) {
+    _protocol = protocol;
+    if (!connect())
+      return false;
+    return hello();
+}
+
+bool RedisClient::hello() {
+    startCmd(2, RedisCmd_HELLO);
+    addLongArg(_protocol);
+    if (!sendCmd())
+      return false;
+
+    // The server's details, a map with RESP3. Only its type is of interest.
+    RedisResult type = resultType();
+    if (type == RedisResult_ERROR || type == RedisResult_NONE)
+      return false;
+    _resp3 = type == RedisResult_MAP;
+    return true;
+}
+
+// Disconnect from the currently connected REDIS. Commands connect again, poll() doesn't.
 
 void RedisClient::disconnect() {
+  _keep = false;
+  drop();
+}
+
+// Close the connection, after a failure: what was on its way is lost. poll() connects again.
+
+void RedisClient::drop() {
+  _pipelining = false;
+  _asyncArmed = false;
+  _rxPos = 0;
+  _rxLen = 0;
+  _parser.reset();
+  _pushStreaming = false;
+  _pushDone = 0;
+  _clientId = 0;
+  _cacheTracked = 0;
+  _resp3 = false;
+  _midReply = false;
+  _pingSent = 0;
+  while (_asyncCount > 0)
+    finishAsync(RedisResult_NONE);                              // these replies will never come
   if (!isConnected)
     return;
   isConnected = 0;
-  _client.close();
+#if REDIS_STATS
+  _stats.drops++;
+#endif
+  _transport->close();
+  notify(RedisConnection_DOWN, 0);
 }
 
-// Increment a key. Note, returns a 4 byte signed long. REDIS numbers can be much larger
-// than this. Beware...
+// Increment a key. Note, returns a 4 byte signed long on the Arduino. REDIS numbers can be
+// larger than this, integerOverflowed() tells and lastInteger() has the whole number.
 
 long RedisClient::INCR(char* key) {
     connect();
-    startCmd(2);
-    addArg("INCR");
+    startCmd(2, RedisCmd_INCR);
     addArg(key);
 
-    _client.write(cmdBuf,strlen(cmdBuf));
-    return resultInt();
+    if (!sendCmd())
+      return 0;
+    return readInt();
 }
 
 // Increment a key but return the result in the character buffer. Used to handle very large numbers
@@ -126,18 +282,13 @@ long RedisClient::INCR(char* key) {
 
 long RedisClient::INCR(char* key, char* buffer, long sz) {
     connect();
-    startCmd(2);
-    addArg("INCR");
+    startCmd(2, RedisCmd_INCR);
     addArg(key);
 
-    _client.write(cmdBuf,strlen(cmdBuf)); 
+    if (!sendCmd())
+      return 0;
 
-    long rc = resultType();
-    if (rc != RedisResult_INTEGER) {
-      rc = -1;
-    }    
-    readSingleline(buffer); 
-    return strlen(buffer);
+    return resultText(buffer, sz);
 }
 
 
@@ -145,12 +296,12 @@ long RedisClient::INCR(char* key, char* buffer, long sz) {
 
 long RedisClient::DECR(char* key) {
     connect();
-    startCmd(2);
-    addArg("DECR");
+    startCmd(2, RedisCmd_DECR);
     addArg(key);
   
-    _client.write(cmdBuf,strlen(cmdBuf));
-    return resultInt();
+    if (!sendCmd())
+      return 0;
+    return readInt();
 }
 
 // Decrement a key but return the result in the character buffer
@@ -158,28 +309,23 @@ long RedisClient::DECR(char* key) {
 
 long RedisClient::DECR(char* key, char* buffer, long sz) {
     connect();
-    startCmd(2);
-    addArg("DECR");
+    startCmd(2, RedisCmd_DECR);
     addArg(key);
 
-    _client.write(cmdBuf,strlen(cmdBuf)); 
+    if (!sendCmd())
+      return 0;
 
-    long rc = resultType();
-    if (rc != RedisResult_INTEGER) {
-      rc = -1;
-    }    
-    readSingleline(buffer); 
-    return strlen(buffer);
+    return resultText(buffer, sz);
 }
 
 // Delete a key. Returns 0 if no key was found, else 1 on success.
 
 long RedisClient::DEL(char* key) {
     connect(); 
-    startCmd(2);
-    addArg("DEL");
+    startCmd(2, RedisCmd_DEL);
     addArg(key);
-    _client.write(cmdBuf,strlen(cmdBuf));
+    if (!sendCmd())
+      return 0;
 
     long rc = readInt();
     return rc;
@@ -189,77 +335,74 @@ long RedisClient::DEL(char* key) {
 
 long RedisClient::INCRBY(char* key, long value) {
     connect();
-    startCmd(3);
-    addArg("INCRBY");
+    startCmd(3, RedisCmd_INCRBY);
     addArg(key);
     addLongArg(value);
-    _client.write(cmdBuf,strlen(cmdBuf));
-    return resultInt();
+    if (!sendCmd())
+      return 0;
+    return readInt();
 }
 
 long RedisClient::INCRBY(char* key, long value, char* buffer, long sz) {
     connect();
-    startCmd(3);
-    addArg("INCRBY");
+    startCmd(3, RedisCmd_INCRBY);
     addArg(key);
     addLongArg(value);
 
-    _client.write(cmdBuf,strlen(cmdBuf)); 
+    if (!sendCmd())
+      return 0;
 
-    long rc = resultType();
-    if (rc != RedisResult_INTEGER) {
-      rc = -1;
-    }    
-    readSingleline(buffer); 
-    return strlen(buffer);
+    return resultText(buffer, sz);
 }
 
 // Decrement a key by the 4 byte long value
 
 long RedisClient::DECRBY(char* key, long value) {
     connect();
-    startCmd(3);
-    addArg("DECRBY");
+    startCmd(3, RedisCmd_DECRBY);
     addArg(key);
     addLongArg(value);
-    _client.write(cmdBuf,strlen(cmdBuf));
-    return resultInt();
+    if (!sendCmd())
+      return 0;
+    return readInt();
 }
 
 long RedisClient::DECRBY(char* key, long value, char* buffer, long sz) {
     connect();
-    startCmd(2);
-    addArg("DECRBY");
+    startCmd(3, RedisCmd_DECRBY);
     addArg(key);
     addLongArg(value);
 
-    _client.write(cmdBuf,strlen(cmdBuf)); 
+    if (!sendCmd())
+      return 0;
+
+    return resultText(buffer, sz);
+}
+
+// Increment a key by a floating point amount. Returns 1 on success and the new value in *value.
 
-    long rc = resultType();
-    if (rc != RedisResult_INTEGER) {
-      rc = -1;
-    }    
-    readSingleline(buffer); 
-    return strlen(buffer);
+long RedisClient::INCRBYFLOAT(char* key, double by, double* value) {
+    connect();
+    startCmd(3, RedisCmd_INCRBYFLOAT);
+    addArg(key);
+    addDoubleArg(by);
+    if (!sendCmd())
+      return 0;
+    return resultDouble(value);
 }
 
 // Set a key to a Character string value.
 
 long RedisClient::SET(char* key, char* value) {
     connect();
-    startCmd(3);
-    addArg("SET");
+    startCmd(3, RedisCmd_SET);
     addArg(key);
     addArg(value);
 
-    _client.write(cmdBuf,strlen(cmdBuf));
-    
-    int rc = resultType() == RedisResult_BULK;
-
-    while(_client.available())
-      _client.read();
+    if (!sendCmd())
+      return 0;
 
-    return rc;
+    return resultType() == RedisResult_SINGLELINE;
 }
 
 // Get a value at key. Value is in buffer, method returns the size
@@ -267,24 +410,18 @@ long RedisClient::SET(char* key, char* value) {
 // truncated in buffer.
 
 long RedisClient::GET(char* key, char *buffer, int buflen) {
+    long len;
+    if (cacheGet(key, "", buffer, buflen, &len))
+      return len;
+
     connect();
-    startCmd(2);
-    addArg("GET");
+    startCmd(2, RedisCmd_GET);
     addArg(key);
 
-    _client.write(cmdBuf,strlen(cmdBuf));
-
-    resultType();
-    int rc = readInt();
-    int index = 0;
-    while(index<rc && index < buflen) {
-      buffer[index++] = _client.read();
-    }
-    buffer[index] = 0;
+    if (!sendCmd())
+      return 0;
 
-    while(_client.available())
-      _client.read();
-    return rc;
+    return resultCached(key, "", buffer, buflen);
 }
 
 // Start a RPUSH command.
@@ -295,8 +432,7 @@ void RedisClient::startRPUSH(char* list, int len) {
     connect();
     int k = 2 + len;
 
-    startCmd(k);
-    addArg("RPUSH");
+    startCmd(k, RedisCmd_RPUSH);
     addArg(list);
 }
 
@@ -304,64 +440,77 @@ void RedisClient::startLPUSH(char* list, int len) {
     connect();
     int k = 2 + len;
 
-    startCmd(k);
-    addArg("LPUSH");
+    startCmd(k, RedisCmd_LPUSH);
     addArg(list);
 }
 
 // Add a 4 byte long to the command argument list.
 
 void RedisClient::addLongArg(long arg) {
-   char buffer[20];
-   char sbuf[32];
-   ltoa(arg, buffer,32);
+   addInt64Arg(arg);
+}
+
+// Add a 64 bit integer to the command argument list.
 
-   itoa(strlen(buffer),sbuf,10);
-   strcat(cmdBuf,"$");
-   strcat(cmdBuf,sbuf);
-   strcat(cmdBuf,CRLF);
-   strcat(cmdBuf,buffer);
-   strcat(cmdBuf,CRLF);
+void RedisClient::addInt64Arg(int64_t arg) {
+   endNumberArg(redisFormatInt64(arg, startNumberArg()));
+}
+
+void RedisClient::addUInt64Arg(uint64_t arg) {
+   endNumberArg(redisFormatUInt64(arg, startNumberArg()));
 }
 
 // Add a character argument to the command argument list
 
-void RedisClient::addArg(char* arg) {
-   char buffer[32];
-   itoa(strlen(arg),buffer,10);
-   strcat(cmdBuf,"$");
-   strcat(cmdBuf,buffer);
-   strcat(cmdBuf,CRLF);
-   strcat(cmdBuf,arg);
-   strcat(cmdBuf,CRLF);
+void RedisClient::addArg(const char* arg) {
+   addArg(arg, strlen(arg));
+}
+
+// Add len bytes at arg to the command argument list: $len\r\n, the bytes, \r\n
+
+void RedisClient::addArg(const char* arg, uint16_t len) {
+   appendChar('$');
+   appendUInt(len);
+   append(CRLF, 2);
+   append(arg, len);
+   append(CRLF, 2);
+}
+
+// Add len bytes of binary data as one argument. NULs and any other byte go through as they are.
+
+void RedisClient::addArg(const uint8_t* data, uint16_t len) {
+   addArg((const char*)data, len);
 }
 
-// Add a floating point argument to the command argument list.
-// Note, the value will be at most 6 digits to the
-// left of the decimal and with 2 digits to the right of the
-// decimal
+// Add a floating point argument to the command argument list, as text that reads back as
+// exactly arg and is usually the shortest such text: 1.5, 0.1, 1e+30.
 
 void RedisClient::addFloatArg(float arg) {
-    char buffer[20];
-    char sbuf[32];
-    dtostrf(arg, 6, 2, buffer);
-   int i = 0;
-   for (i=0; i<20 && buffer[i+1] != '.' && buffer[i] == ' '; i++);
-   strcpy(buffer,&buffer[i]);
-   
-   itoa(strlen(buffer),sbuf,10);
-   strcat(cmdBuf,"$");
-   strcat(cmdBuf,sbuf);
-   strcat(cmdBuf,CRLF);
-   strcat(cmdBuf,buffer);
-   strcat(cmdBuf,CRLF);
+   endNumberArg(redisFormatFloat(arg, startNumberArg()));
+}
+
+void RedisClient::addDoubleArg(double arg) {
+   endNumberArg(redisFormatDouble(arg, startNumberArg()));
+}
+
+// Add an RFM12B radio packet as one argument: the header byte followed by the data_len
+// bytes of payload, as received, without expanding them to text.
+
+void RedisClient::sendArgRFMData(uint8_t header, uint8_t *data, uint8_t data_len) {
+   appendChar('$');
+   appendUInt(data_len + 1);
+   append(CRLF, 2);
+   appendChar(header);
+   append((const char*)data, data_len);
+   append(CRLF, 2);
 }
 
 // End the PUSH command, and transmit. Returns the number
 // of items pushed.
 
 long RedisClient::endPUSH() {
-    _client.write(cmdBuf,strlen(cmdBuf));
+    if (!sendCmd())
+      return 0;
     
     long rc = readInt();
     return rc;
@@ -373,34 +522,34 @@ long RedisClient::endPUSH() {
 
 long RedisClient::EXISTS(char* key) {
     connect();
-    startCmd(2);
-    addArg("EXISTS");
+    startCmd(2, RedisCmd_EXISTS);
     addArg(key);
-    _client.write(cmdBuf,strlen(cmdBuf));
-    return resultInt();
+    if (!sendCmd())
+      return 0;
+    return readInt();
 }
 
 // Make the key persist (cancels the EXPIRE)
 
 long RedisClient::PERSIST(char* key) {
    connect();
-   startCmd(2);
-   addArg("PERSIST");
+   startCmd(2, RedisCmd_PERSIST);
    addArg(key);
-    _client.write(cmdBuf,strlen(cmdBuf));
-    return resultInt();
+    if (!sendCmd())
+      return 0;
+    return readInt();
 }
 
 // Expire the given key in the number of seconds set forth in the
 // time parameter. Returns 1 if the timer is set, 0 indicates not set.
 long RedisClient::EXPIRE(char* key, long time) {
   connect();
-  startCmd(3);
-  addArg("EXPIRE");
+  startCmd(3, RedisCmd_EXPIRE);
   addArg(key);
   addLongArg(time);
-  _client.write(cmdBuf,strlen(cmdBuf));
-  return resultInt();
+  if (!sendCmd())
+    return 0;
+  return readInt();
 }
 
 // Determine the time-to-live in seconds for a key. -2 means the
@@ -408,11 +557,11 @@ long RedisClient::EXPIRE(char* key, long time) {
 
 long RedisClient::TTL(char* key) {
   connect();
-  startCmd(2);
-  addArg("TTL");
+  startCmd(2, RedisCmd_TTL);
   addArg(key);
-  _client.write(cmdBuf,strlen(cmdBuf));
-  return resultInt();
+  if (!sendCmd())
+    return 0;
+  return readInt();
 }
 
 // Return the UNIX epoch time in seconds on the REDIS server.
@@ -422,20 +571,11 @@ long RedisClient::TTL(char* key) {
 
 long RedisClient::TIME(char** values) {
     connect();
-    char buffer[32];
-    startCmd(1);
-    addArg("TIME");
-    _client.write(cmdBuf,strlen(cmdBuf));
-
+    startCmd(1, RedisCmd_TIME);
+    if (!sendCmd())
+      return 0;
 
-    resultType();
-    int howMany = readInt();
-    readEncodedLine(buffer, 32);
-    strcpy(values[0],buffer);
-    readEncodedLine(buffer, 32);
-    strcpy(values[1],buffer);
-
-    return howMany;
+    return resultArray(values, 2, 16);
 }
 
 // TRIM values of list from start to stop
@@ -443,45 +583,47 @@ long RedisClient::TIME(char** values) {
 long RedisClient::LTRIM(char* list, long start, long stop) {
     connect();
 
-    startCmd(4);
-    addArg("LTRIM");
+    startCmd(4, RedisCmd_LTRIM);
     addArg(list);
     addLongArg(start);
     addLongArg(stop);
 
-    _client.write(cmdBuf,strlen(cmdBuf));
+    if (!sendCmd())
+      return 0;
 
    return resultType() == RedisResult_SINGLELINE;
 }
 
+// Returns the number of items in the list.
+
+long RedisClient::LLEN(char* list) {
+    connect();
+    startCmd(2, RedisCmd_LLEN);
+    addArg(list);
+
+    if (!sendCmd())
+      return 0;
+
+    return readInt();
+}
+
 // HGET from hash at field, copy into buffer. Returns -1 if key doesn't exist else returns size of buffer
 
 long RedisClient::HGET(char* key, char* field, char* buffer, long sz) {
+    long len;
+    if (cacheGet(key, field, buffer, sz, &len))
+      return len;
+
     connect();
 
-    startCmd(3);
-    addArg("HGET");
+    startCmd(3, RedisCmd_HGET);
     addArg(key);
     addArg(field);
 
-    _client.write(cmdBuf,strlen(cmdBuf));
-
-    long rc = resultType();
-    if (rc == RedisResult_BULK) {
-	rc = readInt();
-	if (rc < 0)
-        	return rc;
-    } 
-    int k = 0;
-    while(k < rc) {
-	if (_client.available()) {
-		buffer[k++] = _client.read();
-	}
-    }
-    buffer[k] = 0;
-    while(_client.available())
-	_client.read();
-    return rc;
+    if (!sendCmd())
+      return 0;
+
+    return resultCached(key, field, buffer, sz);
 }
 
 // HSET key at field with value.
@@ -489,15 +631,15 @@ long RedisClient::HGET(char* key, char* field, char* buffer, long sz) {
 long RedisClient::HSET(char* key, char* field, char* value) {
     connect();
 
-    startCmd(4);
-    addArg("HSET");
+    startCmd(4, RedisCmd_HSET);
     addArg(key);
     addArg(field);
     addArg(value);
 
-    _client.write(cmdBuf,strlen(cmdBuf));
+    if (!sendCmd())
+      return 0;
 
-    return resultInt();
+    return readInt();
 }
 
 // Does field exist in key. Returns 1 if it does, otherwise returns 0 if neither the hash or the field in
@@ -506,14 +648,14 @@ long RedisClient::HSET(char* key, char* field, char* value) {
 long RedisClient::HEXISTS(char* key, char* field) {
     connect();
 
-    startCmd(3);
-    addArg("HEXISTS");
+    startCmd(3, RedisCmd_HEXISTS);
     addArg(key);
     addArg(field);
 
-    _client.write(cmdBuf,strlen(cmdBuf));
+    if (!sendCmd())
+      return 0;
 
-    return resultInt();
+    return readInt();
 }
 
 // Delete a field in the hash key. Returns 1 if it was deleted, returns 0 if either the key or the field dont exist.
@@ -521,220 +663,2668 @@ long RedisClient::HEXISTS(char* key, char* field) {
 long RedisClient::HDEL(char* key, char* field) {
     connect();
 
-    startCmd(3);
-    addArg("HDEL");
+    startCmd(3, RedisCmd_HDEL);
     addArg(key);
     addArg(field);
 
-    _client.write(cmdBuf,strlen(cmdBuf));
+    if (!sendCmd())
+      return 0;
 
     long rc = readInt();
     return rc;
 }
 
+// Increment the number in the hash key at field by a floating point amount. Returns 1 on
+// success and the new value in *value.
+
+long RedisClient::HINCRBYFLOAT(char* key, char* field, double by, double* value) {
+    connect();
+
+    startCmd(4, RedisCmd_HINCRBYFLOAT);
+    addArg(key);
+    addArg(field);
+    addDoubleArg(by);
+
+    if (!sendCmd())
+      return 0;
+
+    return resultDouble(value);
+}
+
 long RedisClient::APPEND(char* list, char* buf) {
     connect();
 
-    startCmd(3);
-    addArg("APPEND");
+    startCmd(3, RedisCmd_APPEND);
     addArg(list);
     addArg(buf);
 
-    _client.write(cmdBuf,strlen(cmdBuf));
+    if (!sendCmd())
+      return 0;
 
-    return resultInt();
+    return readInt();
 }
 
 long RedisClient::LPOP(char* list, char* buf) {
     connect();
-    startCmd(2);
-    addArg("LPOP");
+    startCmd(2, RedisCmd_LPOP);
     addArg(list);
 
-    _client.write(cmdBuf,strlen(cmdBuf)); 
+    if (!sendCmd())
+      return 0;
 
-    long rc = resultType();
-    if (rc != RedisResult_INTEGER) {
-      rc = -1;
-    }    
-    readSingleline(buf); 
-    return strlen(buf);
+    return resultText(buf, 0xffff);
 }
 
 long RedisClient::LSET(char* list, char* value, long index) {
     connect();
 
-    startCmd(4);
-    addArg("LSET");
+    startCmd(4, RedisCmd_LSET);
     addArg(list);
     addLongArg(index);
     addArg(value);
 
-    _client.write(cmdBuf,strlen(cmdBuf));
+    if (!sendCmd())
+      return 0;
 
-    return resultInt();
+    return readInt();
 }
 
 
 long RedisClient::PUBLISH(char* channel, char* buffer) {
     connect();
-    startCmd(3);
-    addArg("PUBLISH");
+    startCmd(3, RedisCmd_PUBLISH);
     addArg(channel);
     addArg(buffer);
-    _client.write(cmdBuf,strlen(cmdBuf));
+    if (!sendCmd())
+      return 0;
     
     long rc = readInt();
     return rc;
 }
 
-// Returns the result type from the REDIS command.
+// Binary values. These take and return the length of the value instead of relying on a \0,
+// so the value may hold any bytes. The buffers are filled completely, nothing is appended.
+// Binary GET and HGET don't use the client side cache.
 
-RedisResult RedisClient::resultType() {
-    if (_resType == RedisResult_NOTRECEIVED) {
-        while(! _client.available() )
-            delay(1);
-
-        switch( _client.read() ) {
-            case  '+': _resType = RedisResult_SINGLELINE; break;
-            case  '-': _resType = RedisResult_ERROR; break;
-            case  ':': _resType = RedisResult_INTEGER; break;
-            case  '$': _resType = RedisResult_BULK; break;
-            case  '*': _resType = RedisResult_MULTIBULK; break;
-        }
+// Set key to the len bytes at value. Returns 1 on success.
+
+long RedisClient::SET(char* key, const uint8_t* value, uint16_t len) {
+    connect();
+    startCmd(3, RedisCmd_SET);
+    addArg(key);
+    addArg(value, len);
+
+    if (!sendCmd())
+      return 0;
+
+    return resultType() == RedisResult_SINGLELINE;
+}
+
+// Get the value at key into buf of size bytes. Returns the length of the value, if it is
+// > size the value was truncated; -1 if the key doesn't exist.
+
+long RedisClient::GET(char* key, uint8_t* buf, uint16_t size) {
+    connect();
+    startCmd(2, RedisCmd_GET);
+    addArg(key);
+
+    if (!sendCmd())
+      return 0;
+
+    return resultData(buf, size);
+}
+
+long RedisClient::HSET(char* key, char* field, const uint8_t* value, uint16_t len) {
+    connect();
+    startCmd(4, RedisCmd_HSET);
+    addArg(key);
+    addArg(field);
+    addArg(value, len);
+
+    if (!sendCmd())
+      return 0;
+
+    return readInt();
+}
+
+long RedisClient::HGET(char* key, char* field, uint8_t* buf, uint16_t size) {
+    connect();
+    startCmd(3, RedisCmd_HGET);
+    addArg(key);
+    addArg(field);
+
+    if (!sendCmd())
+      return 0;
+
+    return resultData(buf, size);
+}
+
+// Append len bytes to the value at key. Returns the new length of the value.
+
+long RedisClient::APPEND(char* key, const uint8_t* data, uint16_t len) {
+    connect();
+    startCmd(3, RedisCmd_APPEND);
+    addArg(key);
+    addArg(data, len);
+
+    if (!sendCmd())
+      return 0;
+
+    return readInt();
+}
+
+// Pop the first value of list into buf of size bytes. Returns its length, -1 if the list is empty.
+
+long RedisClient::LPOP(char* list, uint8_t* buf, uint16_t size) {
+    connect();
+    startCmd(2, RedisCmd_LPOP);
+    addArg(list);
+
+    if (!sendCmd())
+      return 0;
+
+    return resultData(buf, size);
+}
+
+long RedisClient::PUBLISH(char* channel, const uint8_t* data, uint16_t len) {
+    connect();
+    startCmd(3, RedisCmd_PUBLISH);
+    addArg(channel);
+    addArg(data, len);
+
+    if (!sendCmd())
+      return 0;
+
+    return readInt();
+}
+
+// Batch commands. These take arrays instead of making one round trip per key.
+
+// Get the values of n keys. values[i] (size bytes each) gets the value of keys[i], lens[i] its
+// length, or -1 if the key does not exist. lens may be NULL. Returns the number of values.
+
+long RedisClient::MGET(char** keys, uint16_t n, char** values, uint16_t size, long* lens) {
+    connect();
+    startCmd(n + 1, RedisCmd_MGET);
+    for (uint16_t i=0; i<n; i++)
+      addArg(keys[i]);
+    if (!sendCmd())
+      return 0;
+
+    return resultArray(values, n, size, lens);
+}
+
+// Set n keys to their values in one go. Returns 1 on success.
+
+long RedisClient::MSET(char** keys, char** values, uint16_t n) {
+    connect();
+    startCmd(2 * n + 1, RedisCmd_MSET);
+    for (uint16_t i=0; i<n; i++) {
+      addArg(keys[i]);
+      addArg(values[i]);
     }
+    if (!sendCmd())
+      return 0;
+
+    return resultType() == RedisResult_SINGLELINE;
+}
 
-    if (_resType > RedisResult_NOTRECEIVED)
-        return _resType;
+// Get n fields of the hash at key, like MGET. Returns the number of values.
 
-    return RedisResult_NONE;
+long RedisClient::HMGET(char* key, char** fields, uint16_t n, char** values, uint16_t size, long* lens) {
+    connect();
+    startCmd(n + 2, RedisCmd_HMGET);
+    addArg(key);
+    for (uint16_t i=0; i<n; i++)
+      addArg(fields[i]);
+    if (!sendCmd())
+      return 0;
+
+    return resultArray(values, n, size, lens);
 }
 
-// Read a REDIS integer value from the network
+// Set n fields of the hash at key. Returns the number of fields that were added.
 
-long RedisClient::readInt() {
-    long res = 0;
-    int sign = 1;
-    char chr;
-
-    while(1) {
-        while(! _client.available() )
-            delay(1);
-
-        chr = _client.read();
-        if (chr >= '0' && chr <= '9') {
-            res *= 10;
-            res += chr - '0';
-        } else if (chr == '\r') {
-            // ignore
-        } else if (chr == '\n') {
-            _resType = RedisResult_NONE;
-            return res * sign; // returning result
-        } else if (chr == '-') {
-          sign *= -1;
-        }
+long RedisClient::HSET(char* key, char** fields, char** values, uint16_t n) {
+    connect();
+    startCmd(2 * n + 2, RedisCmd_HSET);
+    addArg(key);
+    for (uint16_t i=0; i<n; i++) {
+      addArg(fields[i]);
+      addArg(values[i]);
     }
+    if (!sendCmd())
+      return 0;
+
+    return readInt();
+}
+
+// Get all fields of the hash at key: up to n field names go to fields[] and their values to
+// values[], each buffer size bytes. Returns the number of fields in the hash. The reply is
+// a map with RESP3 and a flat field, value, field... multibulk without, both work.
+
+long RedisClient::HGETALL(char* key, char** fields, char** values, uint16_t n, uint16_t size) {
+    connect();
+    startCmd(2, RedisCmd_HGETALL);
+    addArg(key);
+    if (!sendCmd())
+      return 0;
+
+    return resultHash(fields, values, n, size);
 }
 
-// Read and return the resulting integer value from REDIS.
-uint16_t RedisClient::resultInt() {
-    if (resultType() != RedisResult_INTEGER)
-        return 0;
+// Delete n keys. Returns the number of keys that existed.
+
+long RedisClient::DEL(char** keys, uint16_t n) {
+    connect();
+    startCmd(n + 1, RedisCmd_DEL);
+    for (uint16_t i=0; i<n; i++)
+      addArg(keys[i]);
+    if (!sendCmd())
+      return 0;
 
     return readInt();
 }
 
-// Read a single line terminated by \r\n into buffer.
-// Returns the number of bytes read.
-// TODO: buffer can overflow!
+// Streaming commands. The value is passed through cmdBuf and _rxBuf a piece at a time, so
+// it may be much bigger than either, e.g. a firmware image or a camera frame. Unlike addArg()
+// the value doesn't need to be in memory at all.
 
-uint16_t RedisClient::readSingleline(char *buffer) {
-    char chr;
-    uint8_t offset = 0;
+// Set key to a value of len bytes that source produces.
 
-    while(1) {
-        while(! _client.available() )
-            delay(1);
+long RedisClient::SET(char* key, uint32_t len, RedisSource source, void* ctx) {
+    connect();
+    startCmd(3, RedisCmd_SET);
+    addArg(key);
 
-        chr = _client.read();
-        if (chr >= 32 && chr <= 126) {
-            buffer[offset++] = chr;
-        } else if (chr == '\r') {
-            // ignore
-        } else if (chr == '\n') {
-            _resType = RedisResult_NONE;
-            buffer[offset++] = '\0';
-            return offset; // returning length of string
-        }
-    }
+    if (!sendStream(len, source, ctx))
+      return 0;
+
+    return resultType() == RedisResult_SINGLELINE;
+}
+
+// Append len bytes from source to the value at key. Returns the new length of the value.
+
+long RedisClient::APPEND(char* key, uint32_t len, RedisSource source, void* ctx) {
+    connect();
+    startCmd(3, RedisCmd_APPEND);
+    addArg(key);
+
+    if (!sendStream(len, source, ctx))
+      return 0;
+
+    return readInt();
 }
 
-// Read a single line of status into buffer
-// TODO: Buffer can overflow
+// Overwrite the value at key from offset on. Returns the new length of the value.
+
+long RedisClient::SETRANGE(char* key, long offset, char* value) {
+    connect();
+    startCmd(4, RedisCmd_SETRANGE);
+    addArg(key);
+    addLongArg(offset);
+    addArg(value);
 
-uint16_t RedisClient::resultStatus(char *buffer) {
-    if (resultType() != RedisResult_SINGLELINE)
-        return 0;
+    if (!sendCmd())
+      return 0;
 
-    return readSingleline(buffer);
+    return readInt();
 }
 
-// Read a resultError line from REDIS into buffer.
-// TODO: Buffer can overflow
+long RedisClient::SETRANGE(char* key, long offset, uint32_t len, RedisSource source, void* ctx) {
+    connect();
+    startCmd(4, RedisCmd_SETRANGE);
+    addArg(key);
+    addLongArg(offset);
 
-uint16_t RedisClient::resultError(char *buffer) {
-    if (resultType() != RedisResult_ERROR)
-        return 0;
+    if (!sendStream(len, source, ctx))
+      return 0;
 
-    return readSingleline(buffer);
+    return readInt();
 }
 
-// Read a $n\r\nline-of-stuff\r\n into buffer.
-// Note: buffer_size has to be bigger than result as result there'll be always a \0 appended
+// Get the value at key into sink. Returns its length, -1 if the key does not exist.
+
+long RedisClient::GET(char* key, RedisSink sink, void* ctx) {
+    connect();
+    startCmd(2, RedisCmd_GET);
+    addArg(key);
 
-long RedisClient::readEncodedLine(char *buffer, long buffer_size) {
-    uint16_t result_size = readInt();
+    if (!sendCmd())
+      return 0;
 
-    while(_client.available() < result_size+2)
-        delay(1);
+    return resultStream(sink, ctx);
+}
 
-    for (int i=0;i<result_size;i++ && i < buffer_size - 1) {
-      buffer[i] = _client.read();
-    }
-    buffer[result_size] = '\0';
-    _client.read(); _client.read();
+long RedisClient::HGET(char* key, char* field, RedisSink sink, void* ctx) {
+    connect();
+    startCmd(3, RedisCmd_HGET);
+    addArg(key);
+    addArg(field);
+
+    if (!sendCmd())
+      return 0;
+
+    return resultStream(sink, ctx);
+}
+
+// Get bytes start to end (both inclusive, negative counts from the end) of the value at key.
+// Returns the length of the range, if it is >= sz the range was truncated in buf.
+
+long RedisClient::GETRANGE(char* key, long start, long end, char* buf, long sz) {
+    connect();
+    startCmd(4, RedisCmd_GETRANGE);
+    addArg(key);
+    addLongArg(start);
+    addLongArg(end);
+
+    if (!sendCmd())
+      return 0;
+
+    return resultBulk(buf, sz);
+}
+
+long RedisClient::GETRANGE(char* key, long start, long end, RedisSink sink, void* ctx) {
+    connect();
+    startCmd(4, RedisCmd_GETRANGE);
+    addArg(key);
+    addLongArg(start);
+    addLongArg(end);
+
+    if (!sendCmd())
+      return 0;
+
+    return resultStream(sink, ctx);
+}
 
-    return result_size;
+// Pub/Sub
+//
+// After SUBSCRIBE the server pushes frames at us: ["message", channel, payload],
+// ["pmessage", pattern, channel, payload] and the ["subscribe", channel, count] style
+// confirmations. A frame that fits into the receive buffer is parsed only once it is
+// complete, so the channel and payload handed to the callback are views into the receive
+// buffer. A frame too big for it is streamed, the channel and pattern are then copied and
+// the payload is handed over in pieces.
+//
+// With RESP3 (HELLO(3)) these frames are sent as push (>) data, which can't be mistaken for a
+// reply. The connection then takes other commands while subscribed, and the ["invalidate",
+// [keys]] frames of CLIENT TRACKING come in on it too.
+
+enum {
+    PUSH_OTHER,
+    PUSH_MESSAGE,
+    PUSH_PMESSAGE,
+    PUSH_SUBSCRIBE,
+    PUSH_PSUBSCRIBE,
+    PUSH_UNSUBSCRIBE,
+    PUSH_PUNSUBSCRIBE,
+    PUSH_INVALIDATE
+};
+
+static const char* const pushKinds[] = {
+    "", "message", "pmessage", "subscribe", "psubscribe", "unsubscribe", "punsubscribe", "invalidate"
+};
+
+// Copy a name of len bytes into buf of REDIS_CHANNEL_SIZE, truncating it.
+
+static void copyName(char* buf, const char* name, uint16_t len) {
+    if (len > REDIS_CHANNEL_SIZE - 1)
+      len = REDIS_CHANNEL_SIZE - 1;
+    memcpy(buf, name, len);
+    buf[len] = 0;
 }
 
+// Receives the elements of a push frame.
 
-// Note: buffer_size has to be bigger than result as result there'll be always a \0 appendet
-uint16_t RedisClient::resultBulk(char *buffer, uint16_t buffer_size) {
-    if (resultType() != RedisResult_BULK)
-        return 0;
+void RedisClient::pushHandler(void* ctx, const RedisElement* e) {
+    RedisClient* self = (RedisClient*)ctx;
+    RedisMessage* msg = &self->_msg;
+
+    if (e->depth == 0) {
+      self->_pushKind = PUSH_OTHER;
+      memset(msg, 0, sizeof(*msg));
+      return;
+    }
 
-    uint16_t result_size = readInt();
-    while(_client.available() < result_size+2)
-        delay(1);
+    // An array payload (CLIENT TRACKING invalidations) is handed over one element at a
+    // time. The frame may be parsed again from the start, skip what was delivered.
+    uint8_t kind = self->_pushKind;
+    if (e->depth == 2 && (kind == PUSH_MESSAGE || kind == PUSH_PMESSAGE || kind == PUSH_INVALIDATE)) {
+      if (e->index < self->_pushDone)
+        return;
+      msg->data = e->data;
+      msg->len = e->len;
+      msg->offset = e->offset;
+      msg->total = e->integer;
+      self->deliver();
+      if (e->offset + e->len >= e->integer)
+        self->_pushDone = e->index + 1;
+      return;
+    }
+    if (e->depth != 1)
+      return;
 
-    _client.read((uint8_t*)buffer, result_size);
-    buffer[result_size] = '\0';
+    if (e->index == 0) {
+      for (uint8_t k=PUSH_MESSAGE; k<=PUSH_INVALIDATE; k++) {
+        if (e->len == strlen(pushKinds[k]) && memcmp(e->data, pushKinds[k], e->len) == 0)
+          self->_pushKind = k;
+      }
+      if (self->_pushKind == PUSH_INVALIDATE) {
+        msg->channel = "__redis__:invalidate";                // as it is named without RESP3
+        msg->channelLen = 20;
+      }
+      return;
+    }
 
-    // throw away newline
-    _client.read(); _client.read();
+    uint8_t payload = kind == PUSH_PMESSAGE ? 3 : kind == PUSH_INVALIDATE ? 1 : 2;
 
-    return result_size;
+    if (kind == PUSH_MESSAGE || kind == PUSH_PMESSAGE || kind == PUSH_INVALIDATE) {
+      if (kind == PUSH_PMESSAGE && e->index == 1) {
+        msg->pattern = e->data;
+        msg->patternLen = e->len;
+        if (self->_pushStreaming) {
+          copyName(self->_pushPattern, e->data, e->len);
+          msg->pattern = self->_pushPattern;
+          msg->patternLen = strlen(self->_pushPattern);
+        }
+      } else if (e->index == payload - 1) {
+        msg->channel = e->data;
+        msg->channelLen = e->len;
+        if (self->_pushStreaming) {
+          copyName(self->_pushName, e->data, e->len);
+          msg->channel = self->_pushName;
+          msg->channelLen = strlen(self->_pushName);
+        }
+      } else if (e->index == payload && (e->type == RedisResult_MULTIBULK || e->type == RedisResult_NULL)) {
+        if (e->integer < 0) {
+          msg->total = -1;
+          self->deliver();
+        }
+      } else if (e->index == payload) {
+        if (!self->_pushStreaming && (e->offset != 0 || e->len != e->integer)) {
+          // Comes in pieces, the names won't stay in the receive buffer.
+          self->_pushStreaming = true;
+          copyName(self->_pushName, msg->channel, msg->channelLen);
+          msg->channel = self->_pushName;
+          msg->channelLen = strlen(self->_pushName);
+          if (msg->pattern) {
+            copyName(self->_pushPattern, msg->pattern, msg->patternLen);
+            msg->pattern = self->_pushPattern;
+            msg->patternLen = strlen(self->_pushPattern);
+          }
+        }
+        msg->data = e->data;
+        msg->len = e->len;
+        msg->offset = e->offset;
+        msg->total = e->integer;
+        self->deliver();
+      }
+    } else if (kind != PUSH_OTHER) {
+      if (e->index == 1)
+        copyName(self->_pushName, e->data ? e->data : "", e->data ? e->len : 0);
+      else if (e->index == 2)
+        self->_pushCount = e->integer;
+    }
 }
 
-// Prepare the command buffer.
+// Hand the message (or a piece of it) in _msg to whoever is waiting for it.
+
+void RedisClient::deliver() {
+    RedisMessage* msg = &_msg;
+
+    if (_pushKind == PUSH_INVALIDATE) {
+      if (_cache)
+        invalidateHandler(this, msg);
+      return;
+    }
 
-void RedisClient::startCmd(uint8_t num_args) {
-    char buf[32];
-    _resType = RedisResult_NOTRECEIVED;
-    itoa(num_args,buf,10);
+    if (_waitChannel && _waitLen < 0 && strlen(_waitChannel) == msg->channelLen &&
+        memcmp(_waitChannel, msg->channel, msg->channelLen) == 0) {
+      long room = _waitSize - 1 - msg->offset;
+      long n = msg->len < room ? msg->len : room;
+      if (n > 0) {
+        memcpy(_waitBuf + msg->offset, msg->data, n);
+        _waitBuf[msg->offset + n] = 0;
+      }
+      if (msg->offset + msg->len >= msg->total)
+        _waitLen = msg->total;
+      return;
+    }
 
-    strcpy(cmdBuf,"*");
-    strcat(cmdBuf,buf);
-    strcat(cmdBuf,CRLF);
+    if (_onMessage)
+      _onMessage(_onMessageCtx, msg);
 }
 
+// Read one push frame and dispatch it. If wait is false only what has already arrived is
+// looked at. Returns true if a frame was read.
+
+bool RedisClient::readPush(bool wait) {
+    uint16_t used;
+
+    _parser.setHandler(pushHandler, this);
+    _parser.setWindow(sizeof(_rxBuf));
+    while (1) {
+      if (!_pushStreaming)
+        _parser.reset();
+      RedisParser::Status status = _parser.parse(_rxBuf + _rxPos, _rxLen - _rxPos, &used);
+
+      if (status == RedisParser::PARSE_DONE) {
+        _rxPos += used;
+        _pushStreaming = false;
+        _pushDone = 0;
+        return true;
+      }
+      if (status == RedisParser::PARSE_ERROR) {
+        drop();
+        return false;
+      }
+
+      if (_pushStreaming) {
+        _rxPos += used;
+      } else if (_rxPos == 0 && _rxLen == sizeof(_rxBuf)) {
+        _pushStreaming = true;                                // won't ever fit, stream it from the start
+        continue;
+      }
+      if (!isConnected || !fill(wait)) {
+        if (wait)
+          drop();
+        return false;
+      }
+    }
+}
+
+// Send a (P)(UN)SUBSCRIBE for name and wait for the server to confirm it. Messages that
+// arrive meanwhile are delivered as usual. Returns the number of subscriptions left.
+
+long RedisClient::subscribeCmd(RedisCommand cmd, uint8_t kind, const char* name, bool pattern) {
+    uint8_t i;
+    uint8_t others = 0;
+
+    if (!connect())
+      return 0;
+
+    // With RESP3 asynchronous commands may be in flight, their replies come first.
+    drainAsync();
+
+    for (i=0; i<_subCount; i++) {
+      if (name && _subPattern[i] == pattern && strcmp(_subs[i], name) == 0)
+        break;
+    }
+    if (kind == PUSH_SUBSCRIBE || kind == PUSH_PSUBSCRIBE) {
+      if (i == _subCount && _subCount < REDIS_MAX_SUBSCRIPTIONS) {
+        copyName(_subs[_subCount], name, strlen(name));
+        _subPattern[_subCount++] = pattern;
+      }
+    } else {
+      // Forget the unsubscribed ones.
+      uint8_t k = 0;
+      for (i=0; i<_subCount; i++) {
+        if (_subPattern[i] == pattern && (name == NULL || strcmp(_subs[i], name) == 0))
+          continue;
+        if (k != i) {
+          memcpy(_subs[k], _subs[i], REDIS_CHANNEL_SIZE);
+          _subPattern[k] = _subPattern[i];
+        }
+        k++;
+      }
+      _subCount = k;
+    }
+    for (i=0; i<_subCount; i++) {
+      if (_subPattern[i] != pattern)
+        others++;
+    }
+
+    startCmd(name ? 2 : 1, cmd);
+    if (name)
+      addArg(name);
+    if (!sendCmd())
+      return 0;
+
+    // Unsubscribing from all of them gets one confirmation per name, the last
+    // one counts only the subscriptions of the other kind.
+    while (readPush(true)) {
+      if (_pushKind != kind)
+        continue;
+      if (name ? strcmp(_pushName, name) == 0 : _pushCount <= others) {
+#if REDIS_STATS
+        statReply();
+#endif
+        return _pushCount;
+      }
+    }
+    return 0;
+}
+
+// Subscribe again to everything in _subs, after a reconnect. The confirmations are
+// read and dropped by the dispatcher.
+
+void RedisClient::resubscribe() {
+    uint8_t channels = 0;
+
+    for (uint8_t i=0; i<_subCount; i++) {
+      if (!_subPattern[i])
+        channels++;
+    }
+
+    for (uint8_t pattern=0; pattern<2; pattern++) {
+      uint8_t n = pattern ? _subCount - channels : channels;
+      if (n == 0)
+        continue;
+      startCmd(n + 1, pattern ? RedisCmd_PSUBSCRIBE : RedisCmd_SUBSCRIBE);
+      for (uint8_t i=0; i<_subCount; i++) {
+        if (_subPattern[i] == (bool)pattern)
+          addArg(_subs[i]);
+      }
+      sendCmd();
+    }
+#if REDIS_STATS
+    _statArmed = false;                                         // the confirmations go to the dispatcher
+#endif
+}
+
+// Set the function that gets the Pub/Sub messages, called from poll().
+
+void RedisClient::onMessage(RedisMessageCallback callback, void* ctx) {
+    _onMessage = callback;
+    _onMessageCtx = ctx;
+}
+
+long RedisClient::SUBSCRIBE(char* channel) {
+    return subscribeCmd(RedisCmd_SUBSCRIBE, PUSH_SUBSCRIBE, channel, false);
+}
+
+long RedisClient::PSUBSCRIBE(char* pattern) {
+    return subscribeCmd(RedisCmd_PSUBSCRIBE, PUSH_PSUBSCRIBE, pattern, true);
+}
+
+long RedisClient::UNSUBSCRIBE(char* channel) {
+    return subscribeCmd(RedisCmd_UNSUBSCRIBE, PUSH_UNSUBSCRIBE, channel, false);
+}
+
+long RedisClient::PUNSUBSCRIBE(char* pattern) {
+    return subscribeCmd(RedisCmd_PUNSUBSCRIBE, PUSH_PUNSUBSCRIBE, pattern, true);
+}
+
+// Subscribe to channel (if not already) and wait for the next message on it. The payload is
+// copied into buf of sz bytes. Messages on other channels go to the onMessage() callback.
+// Returns the length of the message, which is >= sz if it was truncated, -1 on failure.
+
+long RedisClient::SUBSCRIBE(char* channel, char* buf, long sz) {
+    if (SUBSCRIBE(channel) == 0)
+      return -1;
+
+    _waitChannel = channel;
+    _waitBuf = buf;
+    _waitSize = sz;
+    _waitLen = -1;
+    if (sz > 0)
+      buf[0] = 0;
+    uint32_t timeout = _replyTimeout;
+    _replyTimeout = 0;                                        // a message may be long in coming
+    while (_waitLen < 0 && readPush(true))
+      ;
+    _replyTimeout = timeout;
+    _waitChannel = NULL;
+    return _waitLen;
+}
+
+// Fill in reply from element e. Text is copied, truncated to fit, and always \0 terminated.
+
+static void fillReply(RedisReply* reply, const RedisElement* e) {
+    reply->type = e->type;
+    reply->integer = e->integer;
+    if (e->type == RedisResult_DOUBLE && !redisParseDouble(e->data, e->len, &reply->number))
+      reply->number = 0;
+    if (reply->buf == NULL || reply->size == 0)
+      return;
+
+    redisCopyElement(reply->buf, reply->size, e);
+    if (e->type == RedisResult_BULK && e->integer < 0)
+      reply->buf[0] = 0;
+}
+
+// Element handler that fills in a RedisReply from the top level of a reply. Elements of a
+// multibulk are skipped.
+
+static void replyHandler(void* ctx, const RedisElement* e) {
+    if (e->depth == 0)
+      fillReply((RedisReply*)ctx, e);
+}
+
+// Everything written to REDIS goes through here, and every wait for it through waitData(),
+// so the stats see all of it.
+
+int RedisClient::write(const uint8_t* buf, uint16_t len) {
+    int n = _transport->write(buf, len);
+#if REDIS_STATS
+    if (n > 0)
+      _stats.bytesSent += n;
+#endif
+    return n;
+}
+
+bool RedisClient::waitData(uint32_t timeout_ms) {
+#if REDIS_STATS
+    unsigned long start = micros();
+    bool ok = _transport->waitAvailable(timeout_ms);
+    _stats.waits++;
+    _stats.waitMicros += micros() - start;
+    return ok;
+#else
+    return _transport->waitAvailable(timeout_ms);
+#endif
+}
+
+// Pull more of the reply into the receive buffer. If wait is set, wait until something
+// arrives and return false only if the connection is gone or stayed silent for the reply
+// timeout. Otherwise take just what is there already and return whether anything was added.
+
+bool RedisClient::fill(bool wait) {
+    if (_rxPos > 0) {
+      memmove(_rxBuf, _rxBuf + _rxPos, _rxLen - _rxPos);
+      _rxLen -= _rxPos;
+      _rxPos = 0;
+    }
+
+    unsigned long start = millis();
+    while (wait) {
+      uint32_t slice = 1000;
+      if (_replyTimeout) {
+        uint32_t waited = millis() - start;
+        if (waited >= _replyTimeout) {
+#if REDIS_STATS
+          _stats.timeouts++;
+#endif
+          return false;
+        }
+        if (_replyTimeout - waited < slice)
+          slice = _replyTimeout - waited;
+      }
+      if (waitData(slice))
+        break;
+      if (!_transport->connected())
+        return false;
+    }
+
+    int n = _transport->read(_rxBuf + _rxLen, sizeof(_rxBuf) - _rxLen);
+    if (n > 0) {
+      _rxLen += n;
+#if REDIS_STATS
+      _stats.bytesReceived += n;
+#endif
+      _lastTraffic = millis();
+      _pingSent = 0;                                          // it's alive
+    }
+    return wait || n > 0;
+}
+
+// Read one complete reply, handing its elements to handler. Returns false if the
+// connection failed or the server sent something that isn't RESP; the connection
+// is then closed, since there's no telling where the next reply starts. A command that
+// is safe to send twice is sent again on a new connection first, and its reply read.
+
+bool RedisClient::readReply(RedisElementHandler handler, void* ctx) {
+    // Replies to asynchronous commands sent earlier come first.
+    drainAsync();
+
+    bool ok;
+    while (!(ok = parseReply(handler, ctx)) && _replay && resend())
+      ;
+    _replay = false;
+#if REDIS_STATS
+    statReply();
+#endif
+    return ok;
+}
+
+bool RedisClient::parseReply(RedisElementHandler handler, void* ctx) {
+    uint16_t used;
+
+    // RESP3 push frames that come before it go to the Pub/Sub and cache dispatcher.
+    while (_resp3) {
+      if (!_pushStreaming) {
+        if (_rxPos == _rxLen && !fill(true)) {
+          drop();
+          return false;
+        }
+        if (_rxBuf[_rxPos] != '>')
+          break;
+      }
+      if (!readPush(true))
+        return false;
+    }
+
+#if REDIS_STATS
+    // Its first byte tells an error reply.
+    if (_rxPos == _rxLen && !fill(true)) {
+      drop();
+      return false;
+    }
+    if (_rxBuf[_rxPos] == '-' || _rxBuf[_rxPos] == '!')
+      _stats.errors++;
+#endif
+
+    _parser.reset();
+    _parser.setWindow(sizeof(_rxBuf));
+    if (_noteRedirects) {
+      _redirect.kind = RedisRedirect_NONE;
+      _replyHandler = handler;
+      _replyCtx = ctx;
+      handler = redirectHandler;
+      ctx = this;
+    }
+    if (_scriptSent) {
+      _scriptSent = false;                                    // only this reply
+      _scriptHandler = handler;
+      _scriptCtx = ctx;
+      handler = scriptHandler;
+      ctx = this;
+    }
+    _parser.setHandler(handler, ctx);
+
+    while (1) {
+      RedisParser::Status status = _parser.parse(_rxBuf + _rxPos, _rxLen - _rxPos, &used);
+      _rxPos += used;
+      if (status == RedisParser::PARSE_DONE)
+        return true;
+      if (status == RedisParser::PARSE_ERROR || !fill(true)) {
+        drop();
+        return false;
+      }
+    }
+}
+
+// Sits between the parser and the reply handler for RedisClusterClient, noting a
+// "-MOVED 3999 127.0.0.1:6381" or "-ASK ..." error in _redirect.
+
+void RedisClient::redirectHandler(void* ctx, const RedisElement* e) {
+    RedisClient* self = (RedisClient*)ctx;
+
+    if (e->depth == 0 && e->type == RedisResult_ERROR) {
+      const char* p = e->data;
+      const char* end = e->data + e->len;
+      RedisRedirect r;
+
+      if (e->len > 6 && memcmp(p, "MOVED ", 6) == 0) {
+        r.kind = RedisRedirect_MOVED;
+        p += 6;
+      } else if (e->len > 4 && memcmp(p, "ASK ", 4) == 0) {
+        r.kind = RedisRedirect_ASK;
+        p += 4;
+      } else {
+        r.kind = RedisRedirect_NONE;
+      }
+
+      if (r.kind != RedisRedirect_NONE) {
+        r.slot = 0;
+        while (p < end && *p >= '0' && *p <= '9')
+          r.slot = r.slot * 10 + (*p++ - '0');
+
+        // a.b.c.d:port, anything else (a host name) leaves ip at 0
+        if (p < end && *p == ' ')
+          p++;
+        const char* host = p;
+        while (p < end && *p != ':')
+          p++;
+        if (!redisParseIP(host, p - host, &r.ip))
+          r.ip = 0;
+        r.port = 0;
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+          r.port = r.port * 10 + (*p - '0');
+        self->_redirect = r;
+      }
+    }
+    self->_replyHandler(self->_replyCtx, e);
+}
+
+// Read one complete reply of any type. If reply is NULL the reply is read and discarded.
+// Bulk and line text is copied into reply->buf (truncated to fit, always \0 terminated);
+// the elements of a multibulk are read and discarded, only their count is kept.
+
+bool RedisClient::readReply(RedisReply* reply) {
+    RedisReply scratch;
+
+    if (reply == NULL)
+      reply = &scratch;
+    reply->type = RedisResult_NONE;
+    reply->integer = 0;
+    if (reply->buf && reply->size)
+      reply->buf[0] = 0;
+    return readReply(replyHandler, reply);
+}
+
+// Read a reply and return its type, RedisResult_NONE if nothing could be read.
+
+RedisResult RedisClient::resultType() {
+    RedisReply reply;
+    readReply(&reply);
+    return reply.type;
+}
+
+// Element handler for integer replies, keeps just the number.
+
+static void intHandler(void* ctx, const RedisElement* e) {
+    if (e->depth == 0 && (e->type == RedisResult_INTEGER || e->type == RedisResult_BOOLEAN))
+      *(int64_t*)ctx = e->integer;
+}
+
+// Read an integer reply and return its value, 0 if the reply isn't an integer. The full
+// 64 bit value is kept for lastInteger().
+
+long RedisClient::readInt() {
+    _lastInt = 0;
+    readReply(intHandler, &_lastInt);
+    return (long)_lastInt;
+}
+
+// The value of the last integer reply. Commands return a long, on an Arduino that is 32 bits;
+// REDIS integers have 64. If integerOverflowed() says the long was cut short, get the exact
+// value here.
+
+int64_t RedisClient::lastInteger() {
+    return _lastInt;
+}
+
+bool RedisClient::integerOverflowed() {
+    return _lastInt != (long)_lastInt;
+}
+
+// Read a reply and copy its text (the digits of an integer, a status, an error or a bulk)
+// into buffer of sz bytes. Returns the length of the text in buffer, 0 if sz is 0.
+
+long RedisClient::resultText(char *buffer, long sz) {
+    RedisReply reply;
+    reply.buf = buffer;
+    reply.size = sz > 0xffff ? 0xffff : sz < 0 ? 0 : sz;
+    readReply(&reply);
+    return reply.size > 0 ? strlen(buffer) : 0;             // else buffer was never written
+}
+
+// Read a bulk reply into buffer of sz bytes. Returns the length of the value, -1 if it
+// does not exist. If the return value is >= sz, the value was truncated in buffer.
+
+long RedisClient::resultBulk(char *buffer, long sz) {
+    RedisReply reply;
+    reply.buf = buffer;
+    reply.size = sz > 0xffff ? 0xffff : sz < 0 ? 0 : sz;
+    readReply(&reply);
+    return reply.type == RedisResult_BULK || reply.type == RedisResult_VERBATIM ? reply.integer : -1;
+}
+
+// Read a bulk reply that holds a number, the reply to INCRBYFLOAT. Returns 1 and the number
+// in *value, 0 if the reply is an error or not a number.
+
+long RedisClient::resultDouble(double* value) {
+    char buffer[REDIS_NUMBER_SIZE + 16];                      // REDIS writes up to 17 digits with %.17Lg
+    long len = resultBulk(buffer, sizeof(buffer));
+    if (len < 0 || len >= (long)sizeof(buffer))
+      return 0;
+    return redisParseDouble(buffer, len, value);
+}
+
+struct ArrayTarget {
+    char** values;                                            // one buffer per element
+    uint16_t n;                                               // number of buffers
+    uint16_t size;                                            // size of each buffer
+    long* lens;                                               // length of each element, -1 for nil; may be NULL
+    long count;                                               // elements in the reply, -1 on nil
+};
+
+// Element handler that copies the elements of a multibulk into separate buffers.
+
+static void arrayHandler(void* ctx, const RedisElement* e) {
+    ArrayTarget* t = (ArrayTarget*)ctx;
+
+    if (e->depth == 0)
+      t->count = e->type == RedisResult_MULTIBULK || e->type == RedisResult_SET ? e->integer : -1;
+    if (e->depth != 1 || e->index >= t->n)
+      return;
+    if (t->lens)
+      t->lens[e->index] = e->integer;
+    redisCopyElement(t->values[e->index], t->size, e);
+}
+
+// Read a multibulk reply, copying up to n elements into values[0..n), each of size bytes.
+// If lens is given, lens[i] gets the full length of element i, -1 if it is nil. Returns the
+// number of elements in the reply, -1 if it was nil.
+
+long RedisClient::resultArray(char** values, uint16_t n, uint16_t size, long* lens) {
+    ArrayTarget t;
+
+    for (uint16_t i=0; i<n; i++) {
+      if (size)
+        values[i][0] = 0;
+      if (lens)
+        lens[i] = -1;
+    }
+    t.values = values;
+    t.n = n;
+    t.size = size;
+    t.lens = lens;
+    t.count = -1;
+    readReply(arrayHandler, &t);
+    return t.count;
+}
+
+struct HashTarget {
+    char** fields;                                            // buffers for the field names
+    char** values;                                            // buffers for the values
+    uint16_t n;                                               // number of fields and values
+    uint16_t size;                                            // size of each buffer
+    long count;                                               // fields in the reply
+};
+
+// Element handler that copies the fields and values of a map, or of a flat multibulk of
+// field, value pairs, into separate buffers.
+
+static void hashHandler(void* ctx, const RedisElement* e) {
+    HashTarget* t = (HashTarget*)ctx;
+
+    if (e->depth == 0) {
+      t->count = e->type == RedisResult_MAP ? e->integer :
+                 e->type == RedisResult_MULTIBULK && e->integer > 0 ? e->integer / 2 : 0;
+      return;
+    }
+    if (e->depth != 1 || e->index / 2 >= t->n || t->size == 0)
+      return;
+
+    redisCopyElement((e->index & 1 ? t->values : t->fields)[e->index / 2], t->size, e);
+}
+
+// Read a hash reply, copying up to n fields and values. Returns the number of fields.
+
+long RedisClient::resultHash(char** fields, char** values, uint16_t n, uint16_t size) {
+    HashTarget t;
+
+    for (uint16_t i=0; i<n && size; i++) {
+      fields[i][0] = 0;
+      values[i][0] = 0;
+    }
+    t.fields = fields;
+    t.values = values;
+    t.n = n;
+    t.size = size;
+    t.count = 0;
+    readReply(hashHandler, &t);
+    return t.count;
+}
+
+struct DataTarget {
+    uint8_t* buf;                                             // where the value goes
+    uint16_t size;                                            // size of buf
+    long len;                                                 // length of the value, -1 on nil
+};
+
+// Element handler that copies a bulk reply into a buffer, as raw bytes.
+
+static void dataHandler(void* ctx, const RedisElement* e) {
+    DataTarget* t = (DataTarget*)ctx;
+
+    if (e->depth != 0 || (e->type != RedisResult_BULK && e->type != RedisResult_VERBATIM) || e->integer < 0)
+      return;
+    t->len = e->integer;
+    if (e->offset < t->size) {
+      uint16_t n = t->size - e->offset < e->len ? t->size - e->offset : e->len;
+      memcpy(t->buf + e->offset, e->data, n);
+    }
+}
+
+// Read a bulk reply into buf of size bytes, without a \0 after it. Returns the length of the
+// value, -1 if it is nil. If the return value is > size, the value was truncated in buf.
+
+long RedisClient::resultData(uint8_t* buf, uint16_t size) {
+    DataTarget t;
+
+    t.buf = buf;
+    t.size = size;
+    t.len = -1;
+    readReply(dataHandler, &t);
+    return t.len;
+}
+
+struct StreamTarget {
+    RedisSink sink;                                           // who gets the value
+    void* ctx;                                                // handed to sink
+    long len;                                                 // length of the value, -1 on nil
+};
+
+// Element handler that passes the pieces of a bulk reply on to a RedisSink.
+
+static void streamHandler(void* ctx, const RedisElement* e) {
+    StreamTarget* t = (StreamTarget*)ctx;
+
+    if (e->depth != 0 || (e->type != RedisResult_BULK && e->type != RedisResult_VERBATIM) || e->integer < 0)
+      return;
+    t->len = e->integer;
+    if (e->len > 0)
+      t->sink(t->ctx, e->data, e->len, e->offset, e->integer);
+}
+
+// Read a bulk reply and hand it to sink, in pieces if it doesn't fit into the receive
+// buffer. Returns the length of the value, -1 if it is nil (or the reply isn't a bulk).
+
+long RedisClient::resultStream(RedisSink sink, void* ctx) {
+    StreamTarget t;
+
+    t.sink = sink;
+    t.ctx = ctx;
+    t.len = -1;
+    _replay = false;                                          // the sink may have had part of it
+    readReply(streamHandler, &t);
+    return t.len;
+}
+
+// The command names, pre-encoded as bulk strings in flash. See RedisCommands.h.
+
+#define REDIS_COMMAND_TEXT(name, len, replay, queue) \
+    static_assert(sizeof(#name) - 1 == len, "wrong length for " #name " in RedisCommands.h"); \
+    static const char RedisCmdText_##name[] PROGMEM = "$" #len CRLF #name CRLF;
+#define REDIS_COMMAND_PTR(name, len, replay, queue) RedisCmdText_##name,
+#define REDIS_COMMAND_SIZE(name, len, replay, queue) sizeof(RedisCmdText_##name) - 1,
+#define REDIS_COMMAND_REPLAY(name, len, replay, queue) replay,
+#define REDIS_COMMAND_QUEUE(name, len, replay, queue) queue,
+
+REDIS_COMMANDS(REDIS_COMMAND_TEXT)
+static const char* const RedisCmdTable[] PROGMEM = { REDIS_COMMANDS(REDIS_COMMAND_PTR) };
+static const uint8_t RedisCmdSize[] PROGMEM = { REDIS_COMMANDS(REDIS_COMMAND_SIZE) };
+static const uint8_t RedisCmdReplay[] PROGMEM = { REDIS_COMMANDS(REDIS_COMMAND_REPLAY) };
+static const uint8_t RedisCmdQueue[] PROGMEM = { REDIS_COMMANDS(REDIS_COMMAND_QUEUE) };
+
+// Prepare the command buffer for a command with num_args arguments, counting the command
+// name cmd itself. In a pipeline the command is appended behind the ones already queued.
+// Only a command sent on its own, while no keys are WATCHed, is ever sent twice.
+
+void RedisClient::startCmd(uint16_t num_args, RedisCommand cmd) {
+    if (!_pipelining)
+      _cmdLen = _cmdKeep;
+    _cmdStart = _cmdLen;
+    _cmdFailed = false;
+    _replay = !_pipelining && !_watching && pgm_read_byte(&RedisCmdReplay[cmd]);
+    _queueable = _queue && !_pipelining && !_asyncArmed && pgm_read_byte(&RedisCmdQueue[cmd]);
+#if REDIS_STATS
+    if (_cmdKeep == 0) {
+      _statCmd = cmd;
+      _statStart = micros();
+      _statArmed = false;
+    }
+#endif
+
+    appendChar('*');
+    appendUInt(num_args);
+    append(CRLF, 2);
+
+    uint8_t len = pgm_read_byte(&RedisCmdSize[cmd]);
+    if (len > sizeof(cmdBuf) - _cmdLen)
+      flushCmd();
+    memcpy_P(cmdBuf + _cmdLen, (const char*)pgm_read_ptr(&RedisCmdTable[cmd]), len);
+    _cmdLen += len;
+}
+
+// Write out what is in the command buffer, even if it is only part of a command, to make
+// room. So a command can be any size, a small buffer only costs more writes.
+
+void RedisClient::flushCmd() {
+    if (_cmdLen > _cmdKeep && write((uint8_t*)cmdBuf + _cmdKeep, _cmdLen - _cmdKeep) < 0)
+      _cmdFailed = true;
+    if (_pipelining)
+      _cmdFlushed = true;
+    _cmdLen = _cmdKeep;
+    _cmdStart = _cmdKeep;
+    _replay = false;                                          // it isn't all in cmdBuf any more
+    _queueable = false;
+    _scriptWhole = false;
+}
+
+// Append len bytes to the command buffer. The write cursor _cmdLen makes this O(1) in
+// the size of the command so far. When the buffer is full it is flushed to the transport.
+
+void RedisClient::append(const char* data, uint16_t len) {
+    while (len > 0) {
+      if (_cmdLen == sizeof(cmdBuf))
+        flushCmd();
+      uint16_t n = sizeof(cmdBuf) - _cmdLen;
+      if (n > len)
+        n = len;
+      memcpy(cmdBuf + _cmdLen, data, n);
+      _cmdLen += n;
+      data += n;
+      len -= n;
+    }
+}
+
+void RedisClient::appendChar(char c) {
+    if (_cmdLen == sizeof(cmdBuf))
+      flushCmd();
+    cmdBuf[_cmdLen++] = c;
+}
+
+// Append the decimal digits of value, used for the *n and $n headers.
+
+void RedisClient::appendUInt(uint32_t value) {
+    char digits[REDIS_NUMBER_SIZE];
+    append(digits, redisFormatUInt64(value, digits));
+}
+
+// Number arguments are formatted straight into the command buffer, behind room for a one
+// digit $n\r\n header. The rare number of 10 or more characters moves up a byte to make
+// room for the second digit.
+
+char* RedisClient::startNumberArg() {
+    if (sizeof(cmdBuf) - _cmdLen < 5 + REDIS_NUMBER_SIZE + 1)  // $nn\r\n, the number, \r\n
+      flushCmd();
+    return cmdBuf + _cmdLen + 4;
+}
+
+void RedisClient::endNumberArg(uint8_t len) {
+    char* p = cmdBuf + _cmdLen;
+
+    *p++ = '$';
+    if (len >= 10) {
+      memmove(p + 4, p + 3, len);
+      *p++ = '0' + len / 10;
+    }
+    *p++ = '0' + len % 10;
+    *p++ = '\r';
+    *p++ = '\n';
+    p += len;
+    *p++ = '\r';
+    *p++ = '\n';
+    _cmdLen = p - cmdBuf;
+}
+
+// Send the command in the command buffer. Returns true if the caller should now read the
+// reply. In a pipeline the command is only queued, false is returned and the reply is
+// collected later by execPipeline(). A command that could not be written is dropped
+// (and removed from the pipeline), overflowed() tells the caller.
+
+bool RedisClient::sendCmd() {
+    if (_cmdFailed) {
+      _cmdLen = _cmdStart;
+      if (_asyncArmed)
+        failArmed();
+      if (!_pipelining)
+        drop();                                               // part of it went out, REDIS waits for the rest
+      return false;
+    }
+
+    if (_asyncArmed) {
+      _replay = false;                                        // poll() has no way to send it again
+      if (write((uint8_t*)cmdBuf,_cmdLen) < 0) {
+        failArmed();                                          // no reply will come for it
+        drop();
+        return false;
+      }
+      _asyncArmed = false;
+      _lastTraffic = millis();
+      _asyncCount++;
+      return false;
+    }
+
+    if (_pipelining) {
+      _pipeCount++;
+      // Keep headroom for the next command, flushing early costs a write, not a round trip.
+      if (_cmdLen > sizeof(cmdBuf) / 2)
+        flushCmd();
+      return false;
+    }
+
+    if (!isConnected && _queueable) {
+      enqueue();
+      return false;
+    }
+
+    _lastTraffic = millis();
+    if (write((uint8_t*)cmdBuf + _cmdKeep, _cmdLen - _cmdKeep) != _cmdLen - _cmdKeep) {
+      drop();
+      if (!_replay || !resend()) {
+        if (_queueable)
+          enqueue();                                          // REDIS doesn't run a command cut off by a closing connection
+        return false;
+      }
+    }
+#if REDIS_STATS
+    _statArmed = _cmdKeep == 0;                               // not HELLO and the like sent by resend()
+#endif
+    return true;
+}
+
+
+// Send the command in cmdBuf again on a new connection, after the one it went out on failed.
+// Connecting sends HELLO, CLIENT ID and the SUBSCRIBEs, they are built in cmdBuf behind the
+// command, which must leave room for them. Returns true if the command went out.
+
+bool RedisClient::resend() {
+    uint16_t len = _cmdLen;
+
+    _replay = false;
+    if (len > sizeof(cmdBuf) - 32)
+      return false;
+    drop();
+    _cmdKeep = len;
+    bool ok = connect();
+    _cmdKeep = 0;
+    _cmdLen = len;
+    _cmdStart = 0;
+    _lastTraffic = millis();
+#if REDIS_STATS
+    _stats.replays++;
+#endif
+    if (ok && write((uint8_t*)cmdBuf, len) == len)
+      return true;
+    drop();
+    return false;
+}
+
+// Send the command in the command buffer with one more argument of len bytes taken from
+// source, cmdBuf is reused to pass the value through in pieces. Like sendCmd() otherwise.
+// If source comes up short the connection is closed, REDIS would wait for the rest.
+
+bool RedisClient::sendStream(uint32_t len, RedisSource source, void* ctx) {
+    appendChar('$');
+    appendUInt(len);
+    append(CRLF, 2);
+    flushCmd();
+
+    for (uint32_t offset = 0; offset < len && !_cmdFailed; ) {
+      uint16_t want = len - offset < sizeof(cmdBuf) ? len - offset : sizeof(cmdBuf);
+      uint16_t n = source(ctx, cmdBuf, want, offset);
+      if (n == 0 || n > want || write((uint8_t*)cmdBuf, n) != n) {
+        drop();
+        return false;
+      }
+      offset += n;
+    }
+    append(CRLF, 2);
+    return sendCmd();
+}
+
+// True if the last command could not be written to the connection and was dropped.
+// (Commands used to have to fit into the command buffer, hence the name.)
+
+bool RedisClient::overflowed() {
+    return _cmdFailed;
+}
+
+// Start queueing commands. Every command method called until execPipeline() is only
+// appended to the command buffer, and returns 0 instead of its result.
+
+void RedisClient::beginPipeline() {
+    connect();
+    _cmdLen = 0;
+    _cmdFlushed = false;
+    _pipeCount = 0;
+    _pipelining = true;
+}
+
+// End the pipeline and write out what is still queued, without reading anything.
+// Returns the number of replies to read.
+
+uint16_t RedisClient::sendPipeline() {
+    uint16_t count = _pipeCount;
+
+    _pipelining = false;
+    _pipeCount = 0;
+    if (_cmdLen)
+      write((uint8_t*)cmdBuf,_cmdLen);
+    _cmdLen = 0;
+    return count;
+}
+
+// Send all commands queued since beginPipeline() in one write, then read their replies
+// in order. replies[i] receives the reply of the i'th queued command, set buf and size in
+// each slot that should keep status, error or bulk text. Replies beyond n are read and
+// thrown away. Returns the number of commands that were in the pipeline.
+
+uint16_t RedisClient::execPipeline(RedisReply* replies, uint16_t n) {
+    uint16_t count = sendPipeline();
+
+    for (uint16_t i=0; i<count; i++) {
+      if (!readReply(i < n ? &replies[i] : NULL))
+        return i;
+    }
+    return count;
+}
+
+// Transactions
+//
+// MULTI() starts queueing commands just like beginPipeline(), with a MULTI in front.
+// EXEC() appends the EXEC, sends the whole transaction in one write and unpacks the
+// EXEC reply into one RedisReply per command.
+
+// Watch key: if it is changed by someone else before EXEC, the transaction is not executed.
+// Returns 1 on success. Call it before MULTI().
+
+long RedisClient::WATCH(char* key) {
+    connect();
+    startCmd(2, RedisCmd_WATCH);
+    addArg(key);
+    if (!sendCmd())
+      return 0;
+
+    _watching = true;
+    return resultType() == RedisResult_SINGLELINE;
+}
+
+// Forget all WATCHed keys.
+
+long RedisClient::UNWATCH() {
+    connect();
+    startCmd(1, RedisCmd_UNWATCH);
+    if (!sendCmd())
+      return 0;
+
+    _watching = false;
+    return resultType() == RedisResult_SINGLELINE;
+}
+
+// Start a transaction. The command methods called until EXEC() are queued and return 0.
+
+void RedisClient::MULTI() {
+    beginPipeline();
+    _inMulti = true;
+    startCmd(1, RedisCmd_MULTI);
+    sendCmd();
+}
+
+// Throw away the queued transaction, nothing of it has been sent yet. Also drops the WATCHes.
+
+long RedisClient::DISCARD() {
+    if (!_inMulti)
+      return 0;
+
+    _inMulti = false;
+    if (_cmdFlushed) {
+      // Part of the transaction is at the server already, let it drop the rest there.
+      startCmd(1, RedisCmd_DISCARD);
+      sendCmd();
+      execPipeline(NULL, 0);
+      _watching = false;
+      return 1;
+    }
+
+    _pipelining = false;
+    _pipeCount = 0;
+    _cmdLen = 0;
+    if (_watching)
+      UNWATCH();
+    return 1;
+}
+
+struct ExecTarget {
+    RedisReply* replies;                                      // one per queued command
+    uint16_t n;                                               // number of replies
+    long count;                                               // what EXEC() returns
+};
+
+// Element handler for the EXEC reply: one element per queued command.
+
+static void execHandler(void* ctx, const RedisElement* e) {
+    ExecTarget* t = (ExecTarget*)ctx;
+
+    if (e->depth == 0 && (e->type == RedisResult_MULTIBULK || e->type == RedisResult_BULK ||
+                          e->type == RedisResult_NULL) && e->integer < 0)
+      t->count = -1;                                          // nil: a WATCHed key changed
+    else if (e->depth == 0)
+      t->count = e->type == RedisResult_MULTIBULK ? e->integer : -2;
+    else if (e->depth == 1 && e->index < t->n)
+      fillReply(&t->replies[e->index], e);
+}
+
+// Send the transaction and read the results: replies[i] gets the result of the i'th queued
+// command (set buf and size in the slots whose text you want). Returns the number of commands
+// executed, -1 if a WATCHed key was changed so nothing was executed, or -2 if REDIS refused
+// the transaction; the slot of a command REDIS would not queue then holds its error.
+
+long RedisClient::EXEC(RedisReply* replies, uint16_t n) {
+    ExecTarget t;
+
+    if (!_inMulti)
+      return -2;
+
+    startCmd(1, RedisCmd_EXEC);
+    sendCmd();
+
+    uint16_t queued = _pipeCount - 2;
+    _inMulti = false;
+    _watching = false;
+    _pipelining = false;
+    _pipeCount = 0;
+    if (_cmdLen)
+      write((uint8_t*)cmdBuf,_cmdLen);
+    _cmdLen = 0;
+
+    // +OK for the MULTI, then a +QUEUED (or an error) per command.
+    if (!readReply((RedisReply*)NULL))
+      return -2;
+    for (uint16_t i=0; i<queued; i++) {
+      RedisReply* slot = i < n ? &replies[i] : NULL;
+      if (!readReply(slot))
+        return -2;
+      if (slot && slot->type != RedisResult_ERROR)
+        slot->type = RedisResult_NONE;
+    }
+
+    t.replies = replies;
+    t.n = n;
+    t.count = -2;
+    if (!readReply(execHandler, &t))
+      return -2;
+    return t.count;
+}
+
+// Send the next command asynchronously. The command method called next writes the command
+// and returns 0 at once; when the reply has arrived poll() calls callback(ctx, handle, reply).
+// Status, error and bulk text is copied to buf (size bytes) if given. If timeout_ms is not 0
+// and the reply is not in by then, the callback gets a RedisResult_TIMEOUT reply instead and
+// the connection is closed, since the late reply would be taken for the next one.
+// Returns the handle of the command, 0 if too many commands are in flight.
+
+uint16_t RedisClient::async(RedisCallback callback, void* ctx, uint32_t timeout_ms, char* buf, uint16_t size) {
+    if (_asyncCount >= REDIS_MAX_ASYNC || _pipelining || (_subCount > 0 && !_resp3))
+      return 0;
+
+    RedisAsyncSlot* slot = &_async[(_asyncHead + _asyncCount) % REDIS_MAX_ASYNC];
+    if (++_asyncHandle == 0)
+      _asyncHandle = 1;
+    slot->handle = _asyncHandle;
+    slot->callback = callback;
+    slot->ctx = ctx;
+    slot->start = millis();
+    slot->timeout = timeout_ms;
+    slot->reply = RedisReply();
+    slot->reply.buf = buf;
+    slot->reply.size = buf ? size : 0;
+    if (slot->reply.size)
+      buf[0] = 0;
+
+    _asyncArmed = true;
+    return slot->handle;
+}
+
+// Number of asynchronous commands still waiting for their reply.
+
+uint16_t RedisClient::pending() {
+    return _asyncCount;
+}
+
+// The command armed by async() could not be sent, tell the caller right away: its callback
+// gets a RedisResult_NONE reply.
+
+void RedisClient::failArmed() {
+    RedisAsyncSlot* slot = &_async[(_asyncHead + _asyncCount) % REDIS_MAX_ASYNC];
+
+    _asyncArmed = false;
+    if (slot->callback)
+      slot->callback(slot->ctx, slot->handle, &slot->reply);
+}
+
+// Complete the oldest asynchronous command with a reply of the given type.
+
+void RedisClient::finishAsync(RedisResult type) {
+    RedisAsyncSlot slot = _async[_asyncHead];
+
+    _asyncHead = (_asyncHead + 1) % REDIS_MAX_ASYNC;
+    _asyncCount--;
+    slot.reply.type = type;
+#if REDIS_STATS
+    if (type == RedisResult_ERROR)
+      _stats.errors++;
+#endif
+    if (slot.callback)
+      slot.callback(slot.ctx, slot.handle, &slot.reply);
+}
+
+// Advance the asynchronous commands without blocking: parse whatever replies have arrived,
+// fire their callbacks and expire commands that are past their deadline. Call it often,
+// e.g. every time through loop(). Returns the number of callbacks fired. It also connects
+// again after a failure, which can take as long as the network stack needs.
+
+uint16_t RedisClient::poll() {
+    tend();
+    return pollReplies();
+}
+
+// Look after the connection, for poll(): notice that it was closed, connect again once the
+// backoff allows, and send the keep alive PING. Its reply is read like that of an asynchronous
+// command; while subscribed with RESP2 it comes as a push frame that is dropped, any byte
+// from the server will do.
+
+void RedisClient::tend() {
+    if (isConnected && !_transport->connected())
+      drop();
+    if (!isConnected) {
+      if (_keep)
+        connect();
+      return;
+    }
+
+    unsigned long now = millis();
+    uint32_t timeout = _replyTimeout ? _replyTimeout : _keepAlive;
+    if (_pingSent && now - _pingSent >= timeout) {
+      drop();                                                 // no answer, it's dead
+      return;
+    }
+    if (_keepAlive == 0 || _pingSent || _pipelining || _asyncCount > 0 || now - _lastTraffic < _keepAlive)
+      return;
+
+    if (_subCount > 0 && !_resp3) {
+      startCmd(1, RedisCmd_PING);
+      sendCmd();
+      _pingSent = now ? now : 1;
+#if REDIS_STATS
+      _statArmed = false;                                     // the answer is a push frame
+#endif
+    } else if (async(NULL, NULL, timeout)) {
+      startCmd(1, RedisCmd_PING);
+      sendCmd();
+    }
+}
+
+uint16_t RedisClient::pollReplies() {
+    uint16_t fired = 0;
+    uint16_t used;
+
+    if (_subCount > 0 && !_resp3) {
+      while (readPush(false))
+        fired++;
+      return fired;
+    }
+
+    while (1) {
+      // With RESP3 push frames can come in between the replies.
+      if (_resp3 && !_midReply && (_pushStreaming || ((_rxPos < _rxLen || fill(false)) && _rxBuf[_rxPos] == '>'))) {
+        if (!readPush(false))
+          break;
+        fired++;
+        continue;
+      }
+      if (_asyncCount == 0)
+        break;
+
+      RedisAsyncSlot* slot = &_async[_asyncHead];
+
+      _parser.setHandler(replyHandler, &slot->reply);
+      _parser.setWindow(sizeof(_rxBuf));
+      RedisParser::Status status = _parser.parse(_rxBuf + _rxPos, _rxLen - _rxPos, &used);
+      _rxPos += used;
+      _midReply = status == RedisParser::PARSE_MORE && (used > 0 || _midReply);
+
+      if (status == RedisParser::PARSE_DONE) {
+        finishAsync(slot->reply.type);
+        fired++;
+      } else if (status == RedisParser::PARSE_ERROR || !_transport->connected()) {
+        fired += _asyncCount;
+        drop();
+      } else if (!fill(false)) {
+        fired += expireAsync();
+        break;
+      }
+    }
+    return fired;
+}
+
+// Wait until the asynchronous commands in flight have their replies, before a synchronous
+// command reads its own. If the connection stays silent for the reply timeout the commands
+// fail with RedisResult_TIMEOUT and the connection is closed, as for a synchronous reply.
+
+void RedisClient::drainAsync() {
+    while (_asyncCount > 0) {
+      if (pollReplies() > 0 || _asyncCount == 0)
+        continue;
+      if (_replyTimeout && millis() - _lastTraffic >= _replyTimeout) {
+#if REDIS_STATS
+        _stats.timeouts++;
+#endif
+        while (_asyncCount > 0)
+          finishAsync(RedisResult_TIMEOUT);
+        drop();
+        return;
+      }
+      waitData(10);
+    }
+}
+
+// If any asynchronous command is past its deadline, fail it with RedisResult_TIMEOUT and
+// reset the connection; the others then fail with RedisResult_NONE. Returns the number of
+// callbacks fired.
+
+uint16_t RedisClient::expireAsync() {
+    unsigned long now = millis();
+    bool expired = false;
+    uint16_t fired = _asyncCount;
+
+    for (uint8_t i=0; i<_asyncCount; i++) {
+      RedisAsyncSlot* slot = &_async[(_asyncHead + i) % REDIS_MAX_ASYNC];
+      if (slot->timeout && now - slot->start >= slot->timeout)
+        expired = true;
+    }
+    if (!expired)
+      return 0;
+
+    while (_asyncCount > 0) {
+      RedisAsyncSlot* slot = &_async[_asyncHead];
+      bool late = slot->timeout && now - slot->start >= slot->timeout;
+      finishAsync(late ? RedisResult_TIMEOUT : RedisResult_NONE);
+    }
+    drop();
+    return fired;
+}
+
+// The client side cache. GET and HGET look here first. REDIS remembers which keys this
+// connection has read (CLIENT TRACKING) and when one of them changes it publishes the key on
+// __redis__:invalidate to the connection we redirect to, which drops it from the cache.
+// With RESP3 it sends an invalidate push frame on this connection instead.
+// Lookups are a linear search, the cache is meant to hold a handful of config values.
+
+static char invalidateChannel[] = "__redis__:invalidate";     // SUBSCRIBE takes a char*
+
+// Use entries[0..n) as the cache. invalidations must be a RedisClient of its own, with its own
+// transport, it is used for nothing else. It may be NULL if this connection speaks RESP3
+// (HELLO(3)). Returns true if REDIS agreed to track our reads.
+
+bool RedisClient::enableCache(RedisCacheEntry* entries, uint8_t n, RedisClient* invalidations) {
+    disableCache();
+
+    _cache = entries;
+    _cacheSize = n;
+    _cacheInval = invalidations;
+    flushCache();
+
+    if (invalidations == NULL)
+      return cacheReady();
+    invalidations->disconnect();
+    invalidations->_cacheOwner = this;
+    invalidations->onMessage(invalidateHandler, this);
+    invalidations->SUBSCRIBE(invalidateChannel);
+    return cacheReady();
+}
+
+// Stop caching, and tell REDIS to stop tracking.
+
+void RedisClient::disableCache() {
+    if (_cache == NULL)
+      return;
+
+    if (_cacheTracked && connect()) {
+      startCmd(3, RedisCmd_CLIENT);
+      addArg("TRACKING");
+      addArg("off");
+      if (sendCmd())
+        resultType();
+    }
+    _cacheTracked = 0;
+    if (_cacheInval) {
+      _cacheInval->UNSUBSCRIBE(invalidateChannel);
+      _cacheInval->onMessage(NULL, NULL);
+      _cacheInval->_cacheOwner = NULL;
+      _cacheInval = NULL;
+    }
+    _cache = NULL;
+    _cacheSize = 0;
+}
+
+void RedisClient::flushCache() {
+    for (uint8_t i=0; i<_cacheSize; i++)
+      _cache[i].stamp = 0;
+}
+
+RedisCacheStats RedisClient::cacheStats() {
+    return _cacheStats;
+}
+
+long RedisClient::clientId() {
+    startCmd(2, RedisCmd_CLIENT);
+    addArg("ID");
+    if (!sendCmd())
+      return 0;
+    return readInt();
+}
+
+// Get the cache ready for a lookup: take the invalidations that have arrived, and if either
+// connection is new, forget everything and have REDIS track us again. Returns false if the
+// cache can't be used right now, GET and HGET then simply go to REDIS.
+
+bool RedisClient::cacheReady() {
+    RedisClient* inval = _cacheInval;
+
+    if (_cache == NULL || _pipelining || _asyncArmed || (_subCount > 0 && !_resp3))
+      return false;
+
+    if (inval == NULL) {
+      // RESP3: the invalidations come in on this connection.
+      if (!connect() || !_resp3) {
+        flushCache();
+        return false;
+      }
+      poll();
+      if (_cacheTracked != 0)
+        return true;
+
+      flushCache();
+      startCmd(3, RedisCmd_CLIENT);
+      addArg("TRACKING");
+      addArg("on");
+      if (!sendCmd() || resultType() != RedisResult_SINGLELINE)
+        return false;
+      _cacheTracked = -1;
+      return true;
+    }
+
+    if (!inval->connect() || inval->_clientId == 0) {
+      flushCache();
+      return false;
+    }
+    inval->poll();
+    if (_cacheTracked != 0 && _cacheTracked == inval->_clientId)
+      return true;
+
+    flushCache();
+    _cacheTracked = 0;
+    if (!connect())
+      return false;
+    startCmd(5, RedisCmd_CLIENT);
+    addArg("TRACKING");
+    addArg("on");
+    addArg("REDIRECT");
+    addLongArg(inval->_clientId);
+    if (!sendCmd() || resultType() != RedisResult_SINGLELINE)
+      return false;
+    _cacheTracked = inval->_clientId;
+    return true;
+}
+
+// Look up key (and hash field, "" for GET) in the cache. On a hit the value is copied into
+// buffer like resultBulk() does, *len is set and true is returned.
+
+bool RedisClient::cacheGet(const char* key, const char* field, char* buffer, long sz, long* len) {
+    if (!cacheReady())
+      return false;
+
+    for (uint8_t i=0; i<_cacheSize; i++) {
+      RedisCacheEntry* e = &_cache[i];
+      if (e->stamp == 0 || strcmp(e->key, key) != 0 || strcmp(e->field, field) != 0)
+        continue;
+
+      e->stamp = ++_cacheClock;
+      _cacheStats.hits++;
+      if (sz > 0) {
+        long n = e->len < sz - 1 ? e->len : sz - 1;
+        if (n < 0)
+          n = 0;
+        memcpy(buffer, e->value, n);
+        buffer[n] = 0;
+      }
+      *len = e->len;
+      return true;
+    }
+    _cacheStats.misses++;
+    return false;
+}
+
+// Read the bulk reply to a GET or HGET of key and field, like resultBulk(), and keep it in
+// the least recently used cache entry if it is small enough.
+
+long RedisClient::resultCached(const char* key, const char* field, char* buffer, long sz) {
+    RedisReply reply;
+    reply.buf = buffer;
+    reply.size = sz > 0xffff ? 0xffff : sz;
+    readReply(&reply);
+    if (reply.type != RedisResult_BULK)
+      return -1;
+
+    // Only a complete value, read while REDIS is tracking this connection, can be cached.
+    if (_cacheSize == 0 || _cacheTracked == 0 || reply.integer >= sz ||
+        reply.integer >= REDIS_CACHE_VALUE_SIZE || strlen(key) >= REDIS_CACHE_KEY_SIZE ||
+        strlen(field) >= REDIS_CACHE_KEY_SIZE)
+      return reply.integer;
+
+    RedisCacheEntry* e = &_cache[0];
+    for (uint8_t i=1; i<_cacheSize && e->stamp != 0; i++) {
+      if (_cache[i].stamp < e->stamp)
+        e = &_cache[i];
+    }
+    strcpy(e->key, key);
+    strcpy(e->field, field);
+    if (reply.integer > 0)
+      memcpy(e->value, buffer, reply.integer);
+    e->len = reply.integer;
+    e->stamp = ++_cacheClock;
+    return reply.integer;
+}
+
+// Drop the cached values of the key of len bytes, all its hash fields too.
+
+void RedisClient::cacheInvalidate(const char* key, uint16_t len) {
+    for (uint8_t i=0; i<_cacheSize; i++) {
+      RedisCacheEntry* e = &_cache[i];
+      if (e->stamp != 0 && strlen(e->key) == len && memcmp(e->key, key, len) == 0)
+        e->stamp = 0;
+    }
+}
+
+// Gets the messages of the invalidation connection. Each is a key that changed; a nil one,
+// or a key too long to have been cached in one piece, means everything may have changed.
+
+void RedisClient::invalidateHandler(void* ctx, const RedisMessage* msg) {
+    RedisClient* self = (RedisClient*)ctx;
+
+    if (msg->channelLen != 20 || memcmp(msg->channel, "__redis__:invalidate", 20) != 0)
+      return;
+
+    self->_cacheStats.invalidations++;
+    if (msg->data != NULL && msg->offset == 0 && msg->len == msg->total)
+      self->cacheInvalidate(msg->data, msg->len);
+    else if (msg->offset == 0)
+      self->flushCache();
+}
+
+// The write-behind queue. It holds commands exactly as they go over the wire, one after the
+// other, so sending it is a single write and saving it a single store call. Taking the oldest
+// command out moves the rest down, which is bounded by the size of the queue and only happens
+// while it is full; the queue stays one piece for the write.
+
+// A queued command: *argc\r\n, then $len\r\n<bytes>\r\n for the name and each argument. The
+// name, key and the argument after the key are picked out, as the whole $len\r\n...\r\n.
+
+struct QueuedCmd {
+    uint16_t size;                                            // bytes of the whole command
+    uint16_t argc;                                            // arguments, counting the name
+    const uint8_t* arg[3];                                    // name, key and next argument, NULL if there is none
+    uint16_t argSize[3];
+};
+
+// Read the decimal number ending in \r\n at *p, and step over it.
+
+static bool queuedNumber(const uint8_t** p, const uint8_t* end, uint32_t* n) {
+    const uint8_t* s = *p;
+
+    *n = 0;
+    while (s < end && *s >= '0' && *s <= '9' && *n < 100000)
+      *n = *n * 10 + (*s++ - '0');
+    if (s == *p || end - s < 2 || s[0] != '\r' || s[1] != '\n')
+      return false;
+    *p = s + 2;
+    return true;
+}
+
+// Parse the command at p, false if the avail bytes there don't hold a whole one.
+
+static bool parseQueued(const uint8_t* p, uint16_t avail, QueuedCmd* c) {
+    const uint8_t* start = p;
+    const uint8_t* end = p + avail;
+    uint32_t n;
+
+    if (p == end || *p++ != '*' || !queuedNumber(&p, end, &n) || n == 0)
+      return false;
+    c->argc = n;
+    for (uint8_t i=0; i<3; i++)
+      c->arg[i] = NULL;
+    for (uint16_t i=0; i<c->argc; i++) {
+      const uint8_t* arg = p;
+      if (p == end || *p++ != '$' || !queuedNumber(&p, end, &n) || (uint32_t)(end - p) < n + 2 ||
+          p[n] != '\r' || p[n+1] != '\n')
+        return false;
+      p += n + 2;
+      if (i < 3) {
+        c->arg[i] = arg;
+        c->argSize[i] = p - arg;
+      }
+    }
+    c->size = p - start;
+    return true;
+}
+
+static bool isCommand(const QueuedCmd* c, RedisCommand cmd) {
+    uint8_t len = pgm_read_byte(&RedisCmdSize[cmd]);
+    return c->argSize[0] == len && memcmp_P(c->arg[0], (const char*)pgm_read_ptr(&RedisCmdTable[cmd]), len) == 0;
+}
+
+static bool sameArg(const QueuedCmd* a, const QueuedCmd* b, uint8_t i) {
+    return a->arg[i] && b->arg[i] && a->argSize[i] == b->argSize[i] && memcmp(a->arg[i], b->arg[i], a->argSize[i]) == 0;
+}
+
+// What a command on one key does to it that a later one can take over: QUEUE_SET (SET, HSET
+// of a field) is undone by the next of its kind, QUEUE_ADD (INCR, INCRBY, DECR, DECRBY) adds
+// up with others of its kind into one INCRBY.
+
+enum { QUEUE_NONE, QUEUE_SET, QUEUE_ADD };
+
+static uint8_t coalesceKind(const QueuedCmd* c) {
+    if ((isCommand(c, RedisCmd_SET) && c->argc == 3) || (isCommand(c, RedisCmd_HSET) && c->argc == 4))
+      return QUEUE_SET;
+    if (((isCommand(c, RedisCmd_INCR) || isCommand(c, RedisCmd_DECR)) && c->argc == 2) ||
+        ((isCommand(c, RedisCmd_INCRBY) || isCommand(c, RedisCmd_DECRBY)) && c->argc == 3))
+      return QUEUE_ADD;
+    return QUEUE_NONE;
+}
+
+// The amount an INCR, INCRBY, DECR or DECRBY adds, false if it isn't a 64 bit integer.
+
+static bool queuedDelta(const QueuedCmd* c, int64_t* delta) {
+    bool decr = isCommand(c, RedisCmd_DECR) || isCommand(c, RedisCmd_DECRBY);
+
+    if (c->argc == 2) {
+      *delta = decr ? -1 : 1;
+      return true;
+    }
+
+    const uint8_t* p = (const uint8_t*)memchr(c->arg[2], '\n', c->argSize[2]) + 1;
+    const uint8_t* end = c->arg[2] + c->argSize[2] - 2;
+    bool neg = p < end && *p == '-';
+    uint64_t v = 0;
+    if (neg)
+      p++;
+    if (p == end || end - p > 19)
+      return false;
+    for (; p < end; p++) {
+      if (*p < '0' || *p > '9')
+        return false;
+      v = v * 10 + (*p - '0');
+    }
+    if (v > ((uint64_t)1 << 63) - 1)                          // also keeps -v and DECRBY's negation in range
+      return false;
+    *delta = neg != decr ? -(int64_t)v : (int64_t)v;
+    return true;
+}
+
+static const int64_t QUEUE_MAX = (int64_t)(((uint64_t)1 << 63) - 1);     // INT64_MAX, which avr-libc hides from C++
+
+// Use buf[0..size) for the write-behind queue. Whatever store has saved is loaded into it,
+// up to the last whole command, and sent when the connection is (or comes) up.
+
+uint16_t RedisClient::enableQueue(uint8_t* buf, uint16_t size, RedisQueuePolicy policy, RedisQueueStore* store) {
+    QueuedCmd c;
+
+    _queue = buf;
+    _queueSize = size;
+    _queuePolicy = policy;
+    _queueStore = store;
+    _queueLen = 0;
+    _queueCount = 0;
+    _queueDropped = 0;
+
+    uint16_t len = store ? store->load(buf, size) : 0;
+    while (_queueLen < len && parseQueued(_queue + _queueLen, len - _queueLen, &c)) {
+      _queueLen += c.size;
+      _queueCount++;
+    }
+    if (_queueCount && isConnected)
+      sendQueue();
+    return _queueCount;
+}
+
+// Stop queueing. What is still queued is forgotten, and so is the stored copy.
+
+void RedisClient::disableQueue() {
+    if (_queue == NULL)
+      return;
+    _queueLen = 0;
+    _queueCount = 0;
+    if (_queueStore)
+      _queueStore->save(_queue, 0);
+    _queue = NULL;
+    _queueStore = NULL;
+    _queueable = false;
+}
+
+uint16_t RedisClient::queued() {
+    return _queueCount;
+}
+
+uint32_t RedisClient::queueDropped() {
+    return _queueDropped;
+}
+
+void RedisClient::unqueue(uint16_t offset, uint16_t len) {
+    memmove(_queue + offset, _queue + offset + len, _queueLen - offset - len);
+    _queueLen -= len;
+    _queueCount--;
+}
+
+// Put the command in cmdBuf[_cmdStart.._cmdLen) at the end of the queue, dropping the oldest
+// commands if there isn't room. Returns false if it is bigger than the whole queue.
+//
+// With RedisQueue_COALESCE, a SET (HSET) replaces the last queued SET (HSET) of the same key
+// (and field), and an INCR, INCRBY, DECR or DECRBY is added to the last queued one on its key,
+// the sum is queued as one INCRBY. Either way the older command is taken out and the new one
+// queued at the end, which leaves REDIS as running both would, provided no other command on
+// that key was queued in between. The last queued command that names the key as its first
+// argument (for an HSET: that isn't an HSET of another field) is the candidate; after an MSET
+// or a DEL of several keys nothing before it is.
+
+bool RedisClient::enqueue() {
+    uint8_t* cmd = (uint8_t*)cmdBuf + _cmdStart;
+    uint16_t len = _cmdLen - _cmdStart;
+    QueuedCmd c;
+
+    _queueable = false;
+    if (_queuePolicy == RedisQueue_COALESCE && parseQueued(cmd, len, &c) && coalesceKind(&c) != QUEUE_NONE) {
+      QueuedCmd q;
+      QueuedCmd last;
+      long lastAt = -1;
+
+      for (uint16_t at = 0; at < _queueLen && parseQueued(_queue + at, _queueLen - at, &q); at += q.size) {
+        if (isCommand(&q, RedisCmd_MSET) || (isCommand(&q, RedisCmd_DEL) && q.argc > 2)) {
+          lastAt = -1;
+        } else if (sameArg(&q, &c, 1) && !(c.argc == 4 && isCommand(&q, RedisCmd_HSET) && q.argc == 4 && !sameArg(&q, &c, 2))) {
+          lastAt = at;
+          last = q;
+        }
+      }
+
+      uint8_t kind = coalesceKind(&c);
+      if (lastAt >= 0 && coalesceKind(&last) == kind) {
+        if (kind == QUEUE_SET && isCommand(&last, isCommand(&c, RedisCmd_SET) ? RedisCmd_SET : RedisCmd_HSET) &&
+            (c.argc == 3 || sameArg(&last, &c, 2))) {
+          unqueue(lastAt, last.size);
+        } else if (kind == QUEUE_ADD) {
+          // Both become one INCRBY, built in cmdBuf behind the new command.
+          int64_t a, b;
+          uint8_t nameLen = pgm_read_byte(&RedisCmdSize[RedisCmd_INCRBY]);
+          char* sum = cmdBuf + _cmdLen;
+          if (queuedDelta(&last, &a) && queuedDelta(&c, &b) &&
+              (b >= 0 ? a <= QUEUE_MAX - b : a >= -QUEUE_MAX - 1 - b) &&
+              sizeof(cmdBuf) - _cmdLen >= 4u + nameLen + c.argSize[1] + 5 + REDIS_NUMBER_SIZE + 2) {
+            char* p = sum;
+            memcpy(p, "*3\r\n", 4);
+            p += 4;
+            memcpy_P(p, (const char*)pgm_read_ptr(&RedisCmdTable[RedisCmd_INCRBY]), nameLen);
+            p += nameLen;
+            memcpy(p, c.arg[1], c.argSize[1]);
+            p += c.argSize[1];
+            char digits[REDIS_NUMBER_SIZE];
+            uint8_t n = redisFormatInt64(a + b, digits);
+            *p++ = '$';
+            if (n >= 10)
+              *p++ = '0' + n / 10;
+            *p++ = '0' + n % 10;
+            *p++ = '\r';
+            *p++ = '\n';
+            memcpy(p, digits, n);
+            p += n;
+            *p++ = '\r';
+            *p++ = '\n';
+            cmd = (uint8_t*)sum;
+            len = p - sum;
+            unqueue(lastAt, last.size);
+          }
+        }
+      }
+    }
+
+    if (len > _queueSize) {
+      _queueDropped++;
+      return false;
+    }
+    while (_queueLen + len > _queueSize) {
+      QueuedCmd oldest;
+      parseQueued(_queue, _queueLen, &oldest);
+      unqueue(0, oldest.size);
+      _queueDropped++;
+    }
+    memcpy(_queue + _queueLen, cmd, len);
+    _queueLen += len;
+    _queueCount++;
+    if (_queueStore)
+      _queueStore->save(_queue, _queueLen);
+    return true;
+}
+
+// Send the queue on the connection that just came up, in one write, and read the replies.
+// They are dropped, errors too: whoever queued the commands has long moved on. If the
+// connection fails half way, the commands not yet answered stay queued for the next one;
+// REDIS may have run some of them, so a queued command can run twice, but isn't lost.
+// A connection subscribed with RESP2 takes no other commands, the queue waits.
+
+void RedisClient::sendQueue() {
+    uint16_t done = 0;
+    uint16_t count = 0;
+    QueuedCmd q;
+
+    if (_queueLen == 0 || (_subCount > 0 && !_resp3))
+      return;
+
+    _lastTraffic = millis();
+    if (write(_queue, _queueLen) != _queueLen) {
+      drop();
+      return;
+    }
+    while (done < _queueLen && parseQueued(_queue + done, _queueLen - done, &q) && readReply((RedisReply*)NULL)) {
+      done += q.size;
+      count++;
+    }
+
+    memmove(_queue, _queue + done, _queueLen - done);
+    _queueLen -= done;
+    _queueCount -= count;
+    if (_queueStore)
+      _queueStore->save(_queue, _queueLen);
+}
+
+// Streams
+//
+// An XREAD reply nests five deep in RESP2: the streams, each a [key, entries] pair, each entry
+// an [ID, fields] pair, the fields a flat run of names and values. RESP3 makes the top a map of
+// key => entries, one level less. entryHandler() walks it as it is parsed and hands every
+// value to the callback, so an entry of any size passes through the receive buffer.
+
+void RedisClient::startXADD(char* stream, long maxlen, uint16_t nfields) {
+    connect();
+    startCmd(3 + (maxlen > 0 ? 3 : 0) + 2 * nfields, RedisCmd_XADD);
+    addArg(stream);
+    if (maxlen > 0) {
+      addArg("MAXLEN", 6);
+      addArg("~", 1);                                         // trim whole macro nodes only, much cheaper
+      addLongArg(maxlen);
+    }
+    addArg("*", 1);
+}
+
+long RedisClient::endXADD(char* id, uint16_t size) {
+    if (!sendCmd())
+      return 0;
+
+    RedisReply reply;
+    reply.buf = id;
+    reply.size = id ? size : 0;
+    readReply(&reply);
+    return reply.type == RedisResult_BULK ? reply.integer : 0;
+}
+
+long RedisClient::XADD(char* stream, long maxlen, char** fields, char** values, uint16_t n, char* id, uint16_t size) {
+    startXADD(stream, maxlen, n);
+    for (uint16_t i=0; i<n; i++) {
+      addArg(fields[i]);
+      addArg(values[i]);
+    }
+    return endXADD(id, size);
+}
+
+// COUNT, BLOCK and the STREAMS of XREAD and XREADGROUP.
+
+void RedisClient::addReadArgs(char** streams, char** ids, uint16_t n, uint16_t count, long block_ms) {
+    if (count > 0) {
+      addArg("COUNT", 5);
+      addLongArg(count);
+    }
+    if (block_ms >= 0) {
+      addArg("BLOCK", 5);
+      addLongArg(block_ms);
+    }
+    addArg("STREAMS", 7);
+    for (uint16_t i=0; i<n; i++)
+      addArg(streams[i]);
+    for (uint16_t i=0; i<n; i++)
+      addArg(ids[i]);
+}
+
+long RedisClient::XREAD(char** streams, char** ids, uint16_t n, uint16_t count, long block_ms,
+                        RedisStreamCallback callback, void* ctx) {
+    connect();
+    startCmd(2 + (count > 0 ? 2 : 0) + (block_ms >= 0 ? 2 : 0) + 2 * n, RedisCmd_XREAD);
+    addReadArgs(streams, ids, n, count, block_ms);
+    if (!sendCmd())
+      return 0;
+
+    return readStream(block_ms, callback, ctx);
+}
+
+long RedisClient::XREADGROUP(char* group, char* consumer, char** streams, char** ids, uint16_t n, uint16_t count,
+                             long block_ms, RedisStreamCallback callback, void* ctx) {
+    connect();
+    startCmd(5 + (count > 0 ? 2 : 0) + (block_ms >= 0 ? 2 : 0) + 2 * n, RedisCmd_XREADGROUP);
+    addArg("GROUP", 5);
+    addArg(group);
+    addArg(consumer);
+    addReadArgs(streams, ids, n, count, block_ms);
+    if (!sendCmd())
+      return 0;
+
+    return readStream(block_ms, callback, ctx);
+}
+
+long RedisClient::XACK(char* stream, char* group, char** ids, uint16_t n) {
+    connect();
+    startCmd(3 + n, RedisCmd_XACK);
+    addArg(stream);
+    addArg(group);
+    for (uint16_t i=0; i<n; i++)
+      addArg(ids[i]);
+    if (!sendCmd())
+      return 0;
+
+    return readInt();
+}
+
+struct EntryTarget {
+    RedisStreamCallback callback;                             // who gets the entries
+    void* ctx;                                                // handed to callback
+    uint8_t shift;                                            // added to the depth to get the RESP2 one
+    long entries;                                             // entries delivered, -1 on an error reply
+    RedisStreamEntry entry;                                   // what the callback gets
+    char stream[REDIS_STREAM_KEY_SIZE];                       // the stream of the entry
+    char id[REDIS_STREAM_ID_SIZE];                            // its ID
+    char field[REDIS_STREAM_FIELD_SIZE];                      // the field whose value comes next
+};
+
+// Element handler that hands the fields of stream entries on to a RedisStreamCallback.
+
+static void entryHandler(void* ctx, const RedisElement* e) {
+    EntryTarget* t = (EntryTarget*)ctx;
+    RedisStreamEntry* entry = &t->entry;
+
+    if (e->depth == 0) {
+      t->shift = e->type == RedisResult_MAP ? 1 : 0;
+      if (e->type == RedisResult_ERROR)
+        t->entries = -1;
+      return;
+    }
+    switch (e->depth + t->shift) {
+    case 2:                                                   // the stream key, or its entries
+      if ((e->index & 1) == 0)
+        redisCopyElement(t->stream, sizeof(t->stream), e);
+      break;
+    case 3:                                                   // an entry
+      t->entries++;
+      t->id[0] = 0;
+      break;
+    case 4:                                                   // its ID, or its fields
+      if (e->index == 0) {
+        redisCopyElement(t->id, sizeof(t->id), e);
+      } else if (e->integer < 0) {
+        entry->index = 0;
+        entry->count = 0;
+        entry->field = NULL;
+        entry->data = NULL;
+        entry->len = 0;
+        entry->offset = 0;
+        entry->total = -1;
+        t->callback(t->ctx, entry);
+      } else {
+        entry->count = e->integer / 2;
+      }
+      break;
+    case 5:                                                   // a field name, or its value
+      if ((e->index & 1) == 0) {
+        redisCopyElement(t->field, sizeof(t->field), e);
+      } else {
+        entry->index = e->index / 2;
+        entry->field = t->field;
+        entry->data = e->data;
+        entry->len = e->len;
+        entry->offset = e->offset;
+        entry->total = e->integer;
+        t->callback(t->ctx, entry);
+      }
+      break;
+    }
+}
+
+// Read the reply to XREAD or XREADGROUP. It is allowed to keep silent for the time it blocks
+// on top of the reply timeout.
+
+long RedisClient::readStream(long block_ms, RedisStreamCallback callback, void* ctx) {
+    EntryTarget t;
+
+    t.callback = callback;
+    t.ctx = ctx;
+    t.shift = 0;
+    t.entries = 0;
+    t.stream[0] = 0;
+    t.id[0] = 0;
+    t.field[0] = 0;
+    t.entry.stream = t.stream;
+    t.entry.id = t.id;
+
+    uint32_t timeout = _replyTimeout;
+    if (block_ms == 0)
+      _replyTimeout = 0;                                      // BLOCK 0 waits for ever
+    else if (block_ms > 0 && _replyTimeout)
+      _replyTimeout += block_ms;
+    readReply(entryHandler, &t);
+    _replyTimeout = timeout;
+    return t.entries;
+}
+
+// Lua scripts
+//
+// EVALSHA names the script by its SHA1. REDIS that doesn't have it answers -NOSCRIPT, which
+// scriptHandler() keeps from the caller while the EVALSHA is still in cmdBuf: SCRIPT LOAD is
+// then built behind it, the two go out together and the caller reads the EVALSHA's second
+// reply as if it were the first. An EVALSHA too big for cmdBuf gets the NOSCRIPT error, the
+// script is loaded all the same and the next call finds it.
+
+RedisScript::RedisScript(const char* source) {
+    this->source = source;
+    redisSha1Hex(source, strlen(source), sha);
+}
+
+void RedisClient::startEVAL(RedisScript* script, uint16_t numkeys, uint16_t numargs) {
+    connect();
+    startCmd(3 + numkeys + numargs, RedisCmd_EVALSHA);
+    _script = script;
+    _scriptWhole = true;
+    addArg(script->sha, REDIS_SHA1_HEX_SIZE - 1);
+    addLongArg(numkeys);
+}
+
+RedisResult RedisClient::endEVAL(RedisReply* reply) {
+    RedisReply scratch;
+
+    if (reply == NULL)
+      reply = &scratch;
+    reply->type = RedisResult_NONE;
+    if (!sendScript())
+      return RedisResult_NONE;
+
+    readReply(reply);
+    if (scriptMissing())
+      readReply(reply);
+    return reply->type;
+}
+
+long RedisClient::endEVAL(char** values, uint16_t n, uint16_t size, long* lens) {
+    if (!sendScript())
+      return 0;
+
+    long count = resultArray(values, n, size, lens);
+    if (scriptMissing())
+      count = resultArray(values, n, size, lens);
+    return count;
+}
+
+// Load script ahead of time, for pipelines and async() which can't fall back to SCRIPT LOAD.
+
+long RedisClient::SCRIPTLOAD(RedisScript* script) {
+    connect();
+    startCmd(3, RedisCmd_SCRIPT);
+    addArg("LOAD", 4);
+    addArg(script->source);
+
+    if (!sendCmd())
+      return 0;
+
+    char sha[REDIS_SHA1_HEX_SIZE];
+    resultText(sha, sizeof(sha));
+    return strcmp(sha, script->sha) == 0;
+}
+
+// Send the EVALSHA in cmdBuf, the next reply is checked for NOSCRIPT.
+
+bool RedisClient::sendScript() {
+    if (_cmdLen > sizeof(cmdBuf) - 32)
+      _scriptWhole = false;                                   // no room left for SCRIPT LOAD behind it
+    _scriptSent = sendCmd();
+    return _scriptSent;
+}
+
+void RedisClient::scriptHandler(void* ctx, const RedisElement* e) {
+    RedisClient* self = (RedisClient*)ctx;
+
+    if (e->depth == 0 && e->type == RedisResult_ERROR && e->len >= 8 && memcmp(e->data, "NOSCRIPT", 8) == 0) {
+      self->_noScript = true;
+      if (self->_scriptWhole)
+        return;                                               // the EVALSHA goes out again, its reply is the one
+    }
+    self->_scriptHandler(self->_scriptCtx, e);
+}
+
+// After the reply to an EVALSHA: if it was NOSCRIPT, send SCRIPT LOAD and the EVALSHA again
+// if it is still in cmdBuf. Returns true if it was, its reply is next.
+
+bool RedisClient::scriptMissing() {
+    if (!_noScript)
+      return false;
+    _noScript = false;
+
+    uint16_t keep = _scriptWhole ? _cmdLen : 0;
+    _cmdKeep = keep;
+    startCmd(3, RedisCmd_SCRIPT);
+    addArg("LOAD", 4);
+    addArg(_script->source);
+    bool ok = sendCmd();
+    _cmdKeep = 0;
+    if (!ok)
+      return false;
+    if (keep && write((uint8_t*)cmdBuf, keep) != keep) {
+      drop();
+      return false;
+    }
+    readReply((RedisReply*)NULL);                             // SCRIPT LOAD's, the SHA1 again
+    return keep != 0;
+}
+
+#if REDIS_STATS
+
+// Stats. Every command sent on its own starts a clock in startCmd(); once sendCmd() has it
+// out, the next reply read is its reply and stops the clock. Commands that connect() and
+// resend() send on their own behalf aren't timed, their time counts for the command that
+// was waiting.
+
+void RedisClient::statReply() {
+    if (!_statArmed || _cmdKeep)
+      return;
+    _statArmed = false;
+
+    uint32_t us = micros() - _statStart;
+    RedisCommandStats* c = &_stats.commands[_statCmd];
+    uint8_t bucket = 0;
+    for (uint32_t v = us; v && bucket < REDIS_STATS_BUCKETS - 1; v >>= 1)
+      bucket++;
+    c->count++;
+    c->totalMicros += us;
+    if (us > c->maxMicros)
+      c->maxMicros = us;
+    c->buckets[bucket]++;
+}
+
+const RedisStats& RedisClient::stats() {
+    return _stats;
+}
+
+void RedisClient::resetStats() {
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+// The microseconds that permille of the replies took no longer than, as far as the buckets
+// tell: the upper end of the bucket the permille'th reply falls into, or the maximum.
+
+static uint32_t statPercentile(const RedisCommandStats* c, uint16_t permille) {
+    uint32_t rank = (uint64_t)c->count * permille / 1000;
+    uint32_t seen = 0;
+
+    for (uint8_t i=0; i<REDIS_STATS_BUCKETS - 1; i++) {
+      seen += c->buckets[i];
+      if (seen > rank)
+        return ((uint32_t)1 << i) < c->maxMicros ? (uint32_t)1 << i : c->maxMicros;
+    }
+    return c->maxMicros;
+}
+
+// Print the stats a line at a time, e.g.
+//
+//   sent 5120 received 1432 bytes, 160 waits 10466us
+//   connects 1 failures 0 drops 0 timeouts 0 replays 0 errors 0
+//   GET 100 mean 87us p50 128us p99 201us p999 201us max 201us
+//
+// p50, p99 and p999 are bucket bounds: half the replies took less than 128us. A bound past
+// the slowest reply is shown as that. Commands that haven't been used are left out.
+
+static char* statText(char* p, const char* text) {
+    while (*text)
+      *p++ = *text++;
+    return p;
+}
+
+static char* statNumber(char* p, const char* label, uint64_t value, const char* unit) {
+    p = statText(p, label);
+    p += redisFormatUInt64(value, p);
+    return statText(p, unit);
+}
+
+void RedisClient::printStats(void (*print)(void* ctx, const char* text), void* ctx) {
+    char line[160];
+    char* p;
+
+    p = statNumber(line, "sent ", _stats.bytesSent, "");
+    p = statNumber(p, " received ", _stats.bytesReceived, " bytes, ");
+    p = statNumber(p, "", _stats.waits, " waits ");
+    p = statNumber(p, "", _stats.waitMicros, "us\n");
+    *p = 0;
+    print(ctx, line);
+    p = statNumber(line, "connects ", _stats.connects, "");
+    p = statNumber(p, " failures ", _stats.connectFailures, "");
+    p = statNumber(p, " drops ", _stats.drops, "");
+    p = statNumber(p, " timeouts ", _stats.timeouts, "");
+    p = statNumber(p, " replays ", _stats.replays, "");
+    p = statNumber(p, " errors ", _stats.errors, "\n");
+    *p = 0;
+    print(ctx, line);
+
+    for (uint8_t i=0; i<RedisCmd_COUNT; i++) {
+      const RedisCommandStats* c = &_stats.commands[i];
+      if (c->count == 0)
+        continue;
+
+      // The name out of its "$3\r\nGET\r\n".
+      uint8_t len = pgm_read_byte(&RedisCmdSize[i]);
+      memcpy_P(line, (const char*)pgm_read_ptr(&RedisCmdTable[i]), len);
+      char* name = (char*)memchr(line, '\n', len) + 1;
+      len -= name - line + 2;
+      memmove(line, name, len);
+      p = line + len;
+
+      p = statNumber(p, " ", c->count, "");
+      p = statNumber(p, " mean ", c->totalMicros / c->count, "us");
+      p = statNumber(p, " p50 ", statPercentile(c, 500), "us");
+      p = statNumber(p, " p99 ", statPercentile(c, 990), "us");
+      p = statNumber(p, " p999 ", statPercentile(c, 999), "us");
+      p = statNumber(p, " max ", c->maxMicros, "us\n");
+      *p = 0;
+      print(ctx, line);
+    }
+}
+
+#ifdef ARDUINO
+
+static void printTo(void* ctx, const char* text) {
+    ((Print*)ctx)->print(text);
+}
+
+void RedisClient::printStats(Print& out) {
+    printStats(printTo, &out);
+}
+
+#else
+
+static void printTo(void* ctx, const char* text) {
+    fputs(text, (FILE*)ctx);
+}
+
+void RedisClient::printStats(FILE* out) {
+    printStats(printTo, out);
+}
+
+#endif
+
+#endif
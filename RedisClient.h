@@ -1,56 +1,508 @@
 #ifndef H_REDIS_RESULT
 #define H_REDIS_RESULT
 
-#include <Adafruit_CC3000.h>
-#include <ccspi.h>
-#include <SPI.h>
-
- enum RedisResult {
-    RedisResult_NONE,
-    RedisResult_NOTRECEIVED,
-    RedisResult_SINGLELINE,
-    RedisResult_ERROR,
-    RedisResult_INTEGER,
-    RedisResult_BULK,
-    RedisResult_MULTIBULK
+#include "RedisTransport.h"
+#include "RedisParser.h"
+#include "RedisCommands.h"
+#include "RedisFormat.h"
+#include "RedisQueueStore.h"
+#include "RedisSha1.h"
+
+#ifdef ARDUINO
+#include "RedisCC3000Transport.h"
+#else
+#include "RedisPosixTransport.h"
+#include "RedisFileQueueStore.h"
+#endif
+
+#ifndef REDIS_RX_BUF_SIZE
+#ifdef ARDUINO
+#define REDIS_RX_BUF_SIZE 128                                 // receive buffer, bigger bulk replies are streamed through it
+#else
+#define REDIS_RX_BUF_SIZE 4096
+#endif
+#endif
+
+#ifndef REDIS_CMD_BUF_SIZE
+#ifdef ARDUINO
+#define REDIS_CMD_BUF_SIZE 256                                // command buffer, bigger commands are written in pieces
+#else
+#define REDIS_CMD_BUF_SIZE 2048
+#endif
+#endif
+
+#if REDIS_CMD_BUF_SIZE < 32
+#error "REDIS_CMD_BUF_SIZE must be at least 32 bytes"
+#endif
+
+#ifndef REDIS_REPLY_TIMEOUT
+#define REDIS_REPLY_TIMEOUT 5000                              // ms a reply may keep silent before the connection is given up, 0 waits forever
+#endif
+
+#ifndef REDIS_RETRY_MIN
+#define REDIS_RETRY_MIN 250                                   // ms after a failed connect before the next attempt
+#endif
+
+#ifndef REDIS_RETRY_MAX
+#define REDIS_RETRY_MAX 16000                                 // the delay doubles with each failure up to this
+#endif
+
+// What the RedisConnectionCallback is told about the connection. It is called from inside a
+// command or poll() and must not send commands itself.
+
+enum RedisConnectionState {
+    RedisConnection_UP,                                       // connected, HELLO and SUBSCRIBEs sent again
+    RedisConnection_DOWN,                                     // the connection closed, failed or timed out
+    RedisConnection_RETRY                                     // a connect failed, the next attempt is retry_ms away
+};
+
+typedef void (*RedisConnectionCallback)(void* ctx, RedisConnectionState state, uint32_t retry_ms);
+
+// One reply read back from REDIS, used to hand back the per-command results of a pipeline.
+// Point buf at storage of size bytes to keep the text of status, error and bulk replies.
+
+struct RedisReply {
+    RedisResult type;                                         // the result type from redis
+    long integer;                                             // integer value, length of bulk/status text, or multibulk count. -1 on nil
+    double number;                                            // value of a RESP3 double
+    char* buf;                                                // caller supplied buffer for the text, may be NULL
+    uint16_t size;                                            // size of buf
+
+    RedisReply() : type(RedisResult_NONE), integer(0), number(0), buf(NULL), size(0) {}
+};
+
+#ifndef REDIS_MAX_ASYNC
+#ifdef ARDUINO
+#define REDIS_MAX_ASYNC 4                                     // asynchronous commands that can be in flight
+#else
+#define REDIS_MAX_ASYNC 64
+#endif
+#endif
+
+// Called by RedisClient::poll() when the reply to an asynchronous command is in, or its
+// deadline passed (reply->type is RedisResult_TIMEOUT) or the connection was lost
+// (RedisResult_NONE). reply and its text are only valid during the call.
+
+typedef void (*RedisCallback)(void* ctx, uint16_t handle, const RedisReply* reply);
+
+// An asynchronous command waiting for its reply.
+
+struct RedisAsyncSlot {
+    uint16_t handle;                                          // returned by async()
+    RedisCallback callback;                                   // who to tell when the reply is in
+    void* ctx;                                                // handed to callback
+    unsigned long start;                                      // millis() when the command was sent
+    uint32_t timeout;                                         // ms the reply may take, 0 for no limit
+    RedisReply reply;                                         // the reply as it is parsed
+};
+
+#ifndef REDIS_MAX_SUBSCRIPTIONS
+#define REDIS_MAX_SUBSCRIPTIONS 4                             // channels and patterns remembered for resubscribing
+#endif
+
+#ifndef REDIS_CHANNEL_SIZE
+#define REDIS_CHANNEL_SIZE 32                                 // longest channel or pattern name + 1
+#endif
+
+// A Pub/Sub message as handed to the RedisMessageCallback. channel, pattern and data point
+// into the receive buffer and are only valid during the call. A message that fits into the
+// receive buffer arrives in one call; a bigger one arrives in pieces, offset tells where data
+// belongs in the payload of total bytes.
+
+struct RedisMessage {
+    const char* channel;                                      // the channel it was published on
+    uint16_t channelLen;
+    const char* pattern;                                      // the PSUBSCRIBE pattern that matched, NULL for SUBSCRIBE
+    uint16_t patternLen;
+    const char* data;                                         // the payload, or a piece of it
+    uint16_t len;                                             // bytes at data
+    long offset;                                              // position of data in the payload
+    long total;                                               // length of the whole payload
+};
+
+// An array payload, as in CLIENT TRACKING invalidations, arrives as one message per element.
+// A nil array arrives as a single message with data NULL and total -1.
+
+typedef void (*RedisMessageCallback)(void* ctx, const RedisMessage* msg);
+
+#ifndef REDIS_CACHE_KEY_SIZE
+#define REDIS_CACHE_KEY_SIZE 32                               // longest cached key or hash field + 1
+#endif
+
+#ifndef REDIS_CACHE_VALUE_SIZE
+#define REDIS_CACHE_VALUE_SIZE 32                             // longest cached value + 1, bigger ones aren't cached
+#endif
+
+// One entry of the client side cache. The application hands an array of these to
+// enableCache(), so the cache takes no RAM unless it is used.
+
+struct RedisCacheEntry {
+    char key[REDIS_CACHE_KEY_SIZE];                           // the key
+    char field[REDIS_CACHE_KEY_SIZE];                         // the hash field for HGET, empty for GET
+    char value[REDIS_CACHE_VALUE_SIZE];                       // the value
+    int16_t len;                                              // length of value, -1 if the key or field doesn't exist
+    uint32_t stamp;                                           // when it was last used, 0 if the entry is free
+};
+
+struct RedisCacheStats {
+    uint32_t hits;                                            // GET/HGET answered from the cache
+    uint32_t misses;                                          // GET/HGET that went to REDIS
+    uint32_t invalidations;                                   // keys REDIS told us have changed
+};
+
+// A -MOVED or -ASK error reply, noted by clients that RedisClusterClient uses.
+
+enum RedisRedirectKind {
+    RedisRedirect_NONE,
+    RedisRedirect_MOVED,                                      // the slot lives on another node now
+    RedisRedirect_ASK                                         // the slot is being moved, ask that node this once
+};
+
+struct RedisRedirect {
+    RedisRedirectKind kind;
+    uint16_t slot;                                            // the hash slot of the key
+    uint32_t ip;                                              // the node to go to, 0 if it isn't an IP address
+    uint16_t port;
+};
+
+#ifndef REDIS_STATS
+#ifdef ARDUINO
+#define REDIS_STATS 0                                         // 1 to collect RedisStats, about 100 bytes of RAM per command
+#else
+#define REDIS_STATS 1
+#endif
+#endif
+
+#ifndef REDIS_STATS_BUCKETS
+#define REDIS_STATS_BUCKETS 24                                // latency buckets per command, the last from 2^22us (4.2s) up
+#endif
+
+// Latencies of one command: from startCmd() until its reply was read, reconnects and resends
+// included. Each bucket counts a power of two of microseconds: buckets[0] holds the ones under
+// 1us, buckets[i] those of 2^(i-1) up to 2^i us, the last one everything longer.
+
+struct RedisCommandStats {
+    uint32_t count;                                           // replies read
+    uint32_t maxMicros;                                       // the slowest of them
+    uint64_t totalMicros;                                     // all of them added up, for the mean
+    uint32_t buckets[REDIS_STATS_BUCKETS];
+};
+
+// What went over the connection and where the time went. Only commands sent on their own and
+// read back synchronously have their latency taken, not pipelined or asynchronous ones.
+
+struct RedisStats {
+    uint32_t bytesSent;                                       // written to the transport
+    uint32_t bytesReceived;                                   // read from it
+    uint32_t waits;                                           // times a reply had to be waited for
+    uint64_t waitMicros;                                      // time spent in those waits
+    uint32_t connects;                                        // connections made
+    uint32_t connectFailures;                                 // connect attempts that failed
+    uint32_t drops;                                           // connections that failed: write error, timeout, closed
+    uint32_t timeouts;                                        // replies that stayed silent past the reply timeout
+    uint32_t replays;                                         // commands sent again on a new connection
+    uint32_t errors;                                          // error replies
+    RedisCommandStats commands[RedisCmd_COUNT];               // latency by command, indexed by RedisCommand
+};
+
+// What the write-behind queue does when a command doesn't fit any more.
+
+enum RedisQueuePolicy {
+    RedisQueue_DROP_OLDEST,                                   // drop the oldest queued commands to make room
+    RedisQueue_COALESCE                                       // first merge with a queued SET, HSET or INCRBY of the same key
+};
+
+// Values too big for the command or receive buffer are streamed. A RedisSource writes up to
+// size bytes of the value, starting at offset, into buf and returns how many it wrote. A
+// RedisSink gets a bulk reply in pieces of len bytes, offset tells where data belongs in the
+// value of total bytes.
+
+typedef uint16_t (*RedisSource)(void* ctx, char* buf, uint16_t size, long offset);
+typedef void (*RedisSink)(void* ctx, const char* data, uint16_t len, long offset, long total);
+
+#ifndef REDIS_STREAM_KEY_SIZE
+#define REDIS_STREAM_KEY_SIZE 32                              // longest stream key kept for the RedisStreamCallback + 1
+#endif
+
+#ifndef REDIS_STREAM_FIELD_SIZE
+#define REDIS_STREAM_FIELD_SIZE 32                            // longest field name kept for it + 1
+#endif
+
+#define REDIS_STREAM_ID_SIZE 42                               // longest entry ID, two 64 bit numbers and a dash, + 1
+
+// One field of a stream entry read by XREAD() or XREADGROUP(), as handed to the
+// RedisStreamCallback. Entries are delivered while the reply is parsed, nothing but the
+// entry's stream, ID and current field name is kept: those are copies, cut to fit. data
+// points into the receive buffer and is only valid during the call. An entry arrives as one
+// call per field, index counting up to count; a value too big for the receive buffer arrives
+// in pieces, offset tells where data belongs in the value of total bytes. A pending entry that
+// was deleted since (XREADGROUP with an ID other than ">") arrives once with count 0 and field
+// and data NULL.
+
+struct RedisStreamEntry {
+    const char* stream;                                       // the stream key
+    const char* id;                                           // the entry ID, "1700000000000-0"
+    uint16_t index;                                           // which field of the entry this is
+    uint16_t count;                                           // fields in the entry
+    const char* field;                                        // the field name
+    const char* data;                                         // the value, or a piece of it
+    uint16_t len;                                             // bytes at data
+    long offset;                                              // position of data in the value
+    long total;                                               // length of the whole value
+};
+
+// Called from inside XREAD() and XREADGROUP() while the reply is read, must not send commands.
+
+typedef void (*RedisStreamCallback)(void* ctx, const RedisStreamEntry* entry);
+
+// A Lua script, run with startEVAL(). REDIS knows it by its SHA1, worked out once here by the
+// constructor; the source is only sent the first time, or when REDIS lost it (a restart,
+// SCRIPT FLUSH). source is kept by the caller and must not change.
+
+struct RedisScript {
+    const char* source;                                       // the Lua code
+    char sha[REDIS_SHA1_HEX_SIZE];                            // its SHA1 in hex
+
+    RedisScript(const char* source);
 };
 
 class RedisClient {
+    friend class RedisShardedClient;
+    friend class RedisClusterClient;
+    friend class RedisCounters;
+
 private:
-    Adafruit_CC3000* _cc3000;                                 // The network object
-    Adafruit_CC3000_Client _client;                           // the network client object
+    RedisTransport* _transport;                               // the network connection to REDIS
+#ifdef ARDUINO
+    RedisCC3000Transport _cc3000Transport;                    // used when constructed with an Adafruit_CC3000
+#endif
     uint32_t ip;                                              // the ip address of the REDIS
     uint16_t port;                                            // the port of the REDIS host
-    RedisResult _resType;                                     // the result type from redis
 
     // internal methods for construction redis packets in Ethernet Chip's memory
-    void startCmd(uint8_t num_args);                          // Start the command sequence
-    uint16_t readSingleline(char *buffer);                    // read a single line
-    long readInt();                                           // read a long from the redis
+    void startCmd(uint16_t num_args, RedisCommand cmd);       // Start the command sequence
+    bool sendCmd();                                           // send (or queue in a pipeline) the command
+    void append(const char* data, uint16_t len);              // append bytes to the command buffer
+    void appendChar(char c);                                  // append one byte to the command buffer
+    void appendUInt(uint32_t value);                          // append a number in decimal
+    char* startNumberArg();                                   // where to format a number argument
+    void endNumberArg(uint8_t len);                           // put the $len\r\n header in front of it
+    void flushCmd();                                          // write out the command buffer to make room
+    uint16_t sendPipeline();                                  // write the queued commands, returns how many
 
     // read back results
-    RedisResult resultType();
-    uint16_t resultInt();
-    uint16_t resultStatus(char *buffer);
-    uint16_t resultError(char *buffer);
-    uint16_t resultBulk(char *buffer, uint16_t buffer_size);
-
+    bool fill(bool wait);                                     // read more of the reply into _rxBuf
+    bool readReply(RedisElementHandler handler, void* ctx);   // parse one reply, elements go to handler
+    bool parseReply(RedisElementHandler handler, void* ctx);  // readReply() on the connection as it is
+    bool readReply(RedisReply* reply);                        // read one reply of any type
+    RedisResult resultType();                                 // read a reply, return its type
+    long readInt();                                           // read an integer reply as a long
+    long resultDouble(double* value);                         // read a bulk reply holding a number
+    long resultText(char *buffer, long sz);                   // copy the text of a reply into buffer
+    long resultBulk(char *buffer, long sz);                   // copy a bulk reply into buffer, -1 on nil
+    long resultArray(char** values, uint16_t n, uint16_t size, long* lens = NULL); // copy multibulk elements into values[]
+    long resultHash(char** fields, char** values, uint16_t n, uint16_t size); // copy a map into fields[] and values[]
+    long resultStream(RedisSink sink, void* ctx);             // hand a bulk reply to sink, -1 on nil
+    long resultData(uint8_t* buf, uint16_t size);             // copy a bulk reply into buf as raw bytes, -1 on nil
+    bool sendStream(uint32_t len, RedisSource source, void* ctx); // send the command with a last argument from source
 
-    long readEncodedLine(char *buffer, long buffer_size);       // read an encoded line '$n\r\nthe-string\r\n'
-    char cmdBuf[2048];                                          // the internal command buffer
+    char cmdBuf[REDIS_CMD_BUF_SIZE];                            // the internal command buffer
+    uint8_t _rxBuf[REDIS_RX_BUF_SIZE];                          // replies are parsed from here
+    uint16_t _rxPos = 0;                                        // next unparsed byte in _rxBuf
+    uint16_t _rxLen = 0;                                        // bytes received into _rxBuf
+    RedisParser _parser;                                        // the reply parser
+    uint16_t _cmdLen = 0;                                       // bytes used in cmdBuf, the write cursor
+    uint16_t _cmdStart = 0;                                     // where the command being built starts in cmdBuf
+    bool _cmdFailed = false;                                    // the command being built could not be written
+    bool _cmdFlushed = false;                                   // part of the pipeline was written already
     int isConnected = 0;                                        // are we connected to REDIS
+    bool _pipelining = false;                                   // queue commands instead of sending them
+    uint16_t _pipeCount = 0;                                    // number of commands queued in the pipeline
+    bool _inMulti = false;                                      // the pipeline is a MULTI/EXEC transaction
+    bool _watching = false;                                     // keys are WATCHed
+    RedisAsyncSlot _async[REDIS_MAX_ASYNC];                     // asynchronous commands in flight, oldest first
+    uint8_t _asyncHead = 0;                                     // index of the oldest in _async
+    uint8_t _asyncCount = 0;                                    // number in flight
+    uint16_t _asyncHandle = 0;                                  // last handle given out
+    bool _asyncArmed = false;                                   // send the next command asynchronously
+    void finishAsync(RedisResult type);                         // complete the oldest asynchronous command
+    RedisMessageCallback _onMessage = NULL;                     // gets the Pub/Sub messages
+    void* _onMessageCtx = NULL;
+    char _subs[REDIS_MAX_SUBSCRIPTIONS][REDIS_CHANNEL_SIZE];    // subscribed channels and patterns
+    bool _subPattern[REDIS_MAX_SUBSCRIPTIONS];                  // _subs[i] is a PSUBSCRIBE pattern
+    uint8_t _subCount = 0;                                      // entries used in _subs
+    uint8_t _pushKind = 0;                                      // what the push frame being read is
+    long _pushCount = 0;                                        // subscription count in a (un)subscribe frame
+    bool _pushStreaming = false;                                // the frame is bigger than _rxBuf
+    char _pushName[REDIS_CHANNEL_SIZE];                         // channel of a (un)subscribe frame, or of a streamed message
+    char _pushPattern[REDIS_CHANNEL_SIZE];                      // pattern of a streamed message
+    uint16_t _pushDone = 0;                                     // elements of an array payload delivered so far
+    RedisMessage _msg;                                          // the message being read
+    char* _waitBuf = NULL;                                      // SUBSCRIBE(channel, buf, sz) collects a message here
+    long _waitSize = 0;
+    long _waitLen = -1;
+    const char* _waitChannel = NULL;
+    static void pushHandler(void* ctx, const RedisElement* e);
+    void deliver();                                             // hand _msg to the callback (or SUBSCRIBE's buffer)
+    bool readPush(bool wait);                                   // read and dispatch one push frame
+    long subscribeCmd(RedisCommand cmd, uint8_t kind, const char* name, bool pattern);
+    void resubscribe();                                         // subscribe again after a reconnect
+    uint16_t expireAsync();                                     // fail the commands if one is past its deadline
+    void failArmed();                                           // the armed command wasn't sent, tell its callback
+    void drainAsync();                                          // wait for the replies of the commands in flight
+    RedisCacheEntry* _cache = NULL;                             // the client side cache, NULL when it's off
+    uint8_t _cacheSize = 0;                                     // entries in _cache
+    uint32_t _cacheClock = 0;                                   // stamp of the last cache access
+    RedisCacheStats _cacheStats = {0, 0, 0};                    // hits, misses and invalidations
+    RedisClient* _cacheInval = NULL;                            // the connection invalidations are redirected to
+    RedisClient* _cacheOwner = NULL;                            // on that connection: whose cache it serves
+    long _clientId = 0;                                         // CLIENT ID of this connection, if _cacheOwner is set
+    long _cacheTracked = 0;                                     // CLIENT ID that tracking is redirected to, 0 if none, -1 for RESP3
+    long clientId();                                            // ask for the CLIENT ID of this connection
+    bool cacheReady();                                          // apply invalidations, (re)start tracking if needed
+    bool cacheGet(const char* key, const char* field, char* buffer, long sz, long* len);
+    long resultCached(const char* key, const char* field, char* buffer, long sz);
+    void cacheInvalidate(const char* key, uint16_t len);        // drop the entries of key
+    static void invalidateHandler(void* ctx, const RedisMessage* msg);
+    bool _noteRedirects = false;                                // look for MOVED and ASK in the replies
+    RedisRedirect _redirect = {RedisRedirect_NONE, 0, 0, 0};    // the one in the last reply
+    RedisElementHandler _replyHandler = NULL;                   // handler the redirect check passes elements on to
+    void* _replyCtx = NULL;
+    static void redirectHandler(void* ctx, const RedisElement* e);
+    uint8_t _protocol = 2;                                      // the RESP version asked for with HELLO
+    bool _resp3 = false;                                        // the connection speaks RESP3
+    bool _midReply = false;                                     // poll() has parsed part of a reply
+    bool hello();                                               // send HELLO _protocol
+    int64_t _lastInt = 0;                                       // the last integer reply read by readInt()
+    bool _keep = false;                                         // connect() was called and disconnect() wasn't
+    bool _replay = false;                                       // the command in cmdBuf may be sent again on a new connection
+    uint16_t _cmdKeep = 0;                                      // bytes at the front of cmdBuf kept for resend(), commands go behind
+    uint32_t _replyTimeout = REDIS_REPLY_TIMEOUT;               // ms of silence before a reply is given up
+    uint32_t _retryMin = REDIS_RETRY_MIN;                       // backoff after the first failed connect
+    uint32_t _retryMax = REDIS_RETRY_MAX;                       // longest backoff
+    uint32_t _retryDelay = 0;                                   // current backoff, doubles with every failure
+    uint32_t _retryWait = 0;                                    // the backoff with jitter, 0 to connect at once
+    unsigned long _retryAt = 0;                                 // millis() of the last failed connect
+    uint32_t _keepAlive = 0;                                    // PING after this many ms without traffic, 0 for never
+    unsigned long _lastTraffic = 0;                             // millis() of the last write or read
+    unsigned long _pingSent = 0;                                // an unanswered keep alive PING while subscribed, 0 if none
+    RedisConnectionCallback _onConnection = NULL;               // hears about connects, losses and retries
+    void* _onConnectionCtx = NULL;
+    void drop();                                                // close a connection that failed
+    bool resend();                                              // send the command in cmdBuf again on a new connection
+    void tend();                                                // reconnect and keep alive, from poll()
+    uint16_t pollReplies();                                     // poll() without tend()
+    void notify(RedisConnectionState state, uint32_t retry_ms);
+    uint8_t* _queue = NULL;                                     // the write-behind queue, NULL when it's off
+    uint16_t _queueSize = 0;                                    // bytes at _queue
+    uint16_t _queueLen = 0;                                     // bytes of queued commands
+    uint16_t _queueCount = 0;                                   // number of queued commands
+    uint32_t _queueDropped = 0;                                 // commands dropped because the queue was full
+    RedisQueuePolicy _queuePolicy = RedisQueue_DROP_OLDEST;
+    RedisQueueStore* _queueStore = NULL;                        // keeps a copy across resets, may be NULL
+    bool _queueable = false;                                    // the command in cmdBuf may go into the queue
+    bool enqueue();                                             // put the command in cmdBuf into the queue
+    void sendQueue();                                           // send the queue on a new connection
+    void unqueue(uint16_t offset, uint16_t len);                // take a command out of the queue
+    RedisScript* _script = NULL;                                // the script of the last startEVAL()
+    bool _scriptWhole = false;                                  // its EVALSHA is still all in cmdBuf
+    bool _scriptSent = false;                                   // the next reply is an EVALSHA's, look for NOSCRIPT
+    bool _noScript = false;                                     // it was NOSCRIPT
+    RedisElementHandler _scriptHandler = NULL;                  // handler the NOSCRIPT check passes elements on to
+    void* _scriptCtx = NULL;
+    static void scriptHandler(void* ctx, const RedisElement* e);
+    void addReadArgs(char** streams, char** ids, uint16_t n, uint16_t count, long block_ms); // COUNT, BLOCK, STREAMS
+    long readStream(long block_ms, RedisStreamCallback callback, void* ctx); // deliver an XREAD reply
+    bool sendScript();                                          // send the EVALSHA in cmdBuf
+    bool scriptMissing();                                       // load the script after NOSCRIPT, true if the EVALSHA went out again
+    int write(const uint8_t* buf, uint16_t len);                // write to the transport, counted
+    bool waitData(uint32_t timeout_ms);                         // wait for the transport, timed
+#if REDIS_STATS
+    RedisStats _stats = RedisStats();                           // see stats()
+    RedisCommand _statCmd = RedisCmd_COUNT;                     // the command being timed
+    unsigned long _statStart = 0;                               // micros() when it was started
+    bool _statArmed = false;                                    // it was sent, its reply is next
+    void statReply();                                           // the reply is in, note how long it took
+    void printStats(void (*print)(void* ctx, const char* text), void* ctx);
+#endif
 
 public:
 
     RedisClient();
+    RedisClient(uint32_t , uint16_t, RedisTransport*);
+#ifdef ARDUINO
     RedisClient(uint32_t , uint16_t, Adafruit_CC3000*);
+#endif
     bool connect();
     bool connect(uint32_t , uint16_t);
     void disconnect();
+    bool connected();                                         // is the connection up, as far as we know
+
+    // Failure handling. A connection that fails (a write error, no reply within the reply
+    // timeout, closed by the server) is closed; the next command or poll() connects again,
+    // with a growing delay between failed attempts. A command marked replay in RedisCommands.h
+    // that was in flight is sent once more on the new connection.
+    void onConnection(RedisConnectionCallback callback, void* ctx); // who hears about connects, losses and retries
+    void setReplyTimeout(uint32_t timeout_ms);                // ms a reply may keep silent, 0 waits forever
+    void setRetry(uint32_t min_ms, uint32_t max_ms);          // backoff between connect attempts
+    void setKeepAlive(uint32_t idle_ms);                      // poll() PINGs after idle_ms without traffic, 0 for never
+    long PING();                                              // returns 1 if REDIS answered
+    bool HELLO(uint8_t protocol);                             // 3 for RESP3, returns true if the server switched
+
+    void beginPipeline();                                     // queue the following commands, they return 0
+    uint16_t execPipeline(RedisReply* replies, uint16_t n);   // send the queue in one write, read the replies in order
 
-    void addArg(char* arg);
+    // Transactions: WATCH keys, MULTI(), the commands (they return 0), then EXEC() or DISCARD().
+    long WATCH(char* key);                                        // abort the transaction if key changes before EXEC
+    long UNWATCH();                                               // forget the WATCHed keys
+    void MULTI();                                                 // start queueing a transaction
+    long EXEC(RedisReply* replies, uint16_t n);                   // send it in one write, results in replies[]; -1 if a WATCHed key changed
+    long DISCARD();                                               // drop the queued transaction
+
+    uint16_t async(RedisCallback callback, void* ctx, uint32_t timeout_ms = 0,
+                   char* buf = NULL, uint16_t size = 0);      // send the next command without waiting, returns its handle
+    uint16_t poll();                                          // advance asynchronous commands, reconnect, keep alive
+    uint16_t pending();                                       // asynchronous commands waiting for a reply
+
+    bool overflowed();                                        // true if the last command could not be sent
+#if REDIS_STATS
+    const RedisStats& stats();                                // counters and latency histograms since resetStats()
+    void resetStats();
+#ifdef ARDUINO
+    void printStats(Print& out);                              // a summary, one line per command used
+#else
+    void printStats(FILE* out);
+#endif
+#endif
+    int64_t lastInteger();                                    // the last integer reply, all 64 bits of it
+    bool integerOverflowed();                                 // the last integer reply didn't fit the long returned
+
+    // Client side cache for GET and HGET of small values, kept up to date by REDIS through
+    // CLIENT TRACKING. invalidations is a second connection that gets the invalidation messages,
+    // NULL if this connection speaks RESP3.
+    bool enableCache(RedisCacheEntry* entries, uint8_t n, RedisClient* invalidations);
+    void disableCache();
+    void flushCache();                                        // forget all cached values
+    RedisCacheStats cacheStats();                             // hit, miss and invalidation counts
+
+    // Write-behind queue. While there is no connection, the commands marked queue in
+    // RedisCommands.h go into buf, as they would have been sent, instead of being lost; they
+    // return 0. When the connection is back they go out in one write, before anything else.
+    // store, if not NULL, keeps a copy that survives a reset. Returns the number of commands
+    // found in the store.
+    uint16_t enableQueue(uint8_t* buf, uint16_t size, RedisQueuePolicy policy, RedisQueueStore* store = NULL);
+    void disableQueue();                                      // stop queueing, forget what is queued
+    uint16_t queued();                                        // commands waiting for the connection
+    uint32_t queueDropped();                                  // commands dropped because the queue was full
+
+    void addArg(const char* arg);
+    void addArg(const char* arg, uint16_t len);               // add len bytes at arg as one argument
+    void addArg(const uint8_t* data, uint16_t len);           // add len bytes of binary data as one argument
     void addLongArg(long arg);
-    void addFloatArg(float arg);
+    void addInt64Arg(int64_t arg);
+    void addUInt64Arg(uint64_t arg);
+    void addFloatArg(float arg);                              // reads back as arg, usually shortest
+    void addDoubleArg(double arg);
 
     /*
      * The REDIS commands the user can use.
@@ -63,7 +515,9 @@ public:
     long DECR(char* key, char* buf, long sz);                     // decrement number store back in buffer
     long DECRBY(char* key, long bu);                              // return decr by number
     long DECRBY(char* key, long value, char* bu, long sz);        // return decr by number
+    long INCRBYFLOAT(char* key, double by, double* value);        // returns 1 on success, the new value in *value
     long LTRIM(char* list, long start, long stop);                // trim a list
+    long LLEN(char* list);                                        // number of items in a list
     long GET(char* key, char *buffer, int buflen);                // returns 1 on success, get value using resultBulk(buffer, buflen);
     long SET(char* key, char* value);                             // returns 1 on success, get value using resultBulk(buffer, buflen);
     long EXISTS(char* key);                                       // returns 1 if key exists, else 0
@@ -73,12 +527,50 @@ public:
     long EXPIRE(char* key, long time);                            // exire key in 'time' seconds
     long TTL(char* key);                                          // time to live in seconds of a key
     long PUBLISH(char* channel, char* buf);                       // publish buf on channel
-    long SUBSCRIBE(char* channel, char* buf, long sz);
+    long SUBSCRIBE(char* channel, char* buf, long sz);            // subscribe, wait for the next message on channel, copy it to buf
+
+    // Pub/Sub. Once subscribed the connection only takes these commands; messages are
+    // delivered to the onMessage() callback from poll().
+    void onMessage(RedisMessageCallback callback, void* ctx);     // who gets the messages
+    long SUBSCRIBE(char* channel);                                // returns the number of subscriptions
+    long PSUBSCRIBE(char* pattern);                               // subscribe to channels matching the glob pattern
+    long UNSUBSCRIBE(char* channel);                              // NULL unsubscribes all channels
+    long PUNSUBSCRIBE(char* pattern);                             // NULL unsubscribes all patterns
 
     long HGET(char* key, char* field, char* buffer, long sz);     // get hash value from key at field.                 
     long HSET(char* key, char* field, char* value);               // set a hash value in hash key, at field
     long HEXISTS(char* key, char* field);                         // does hash field exist in hash set? Returns 1 on exists, or 0                                     
     long HDEL(char* key, char* field);                            // delete a hash field from the hash named at key
+    long HINCRBYFLOAT(char* key, char* field, double by, double* value); // returns 1 on success, the new value in *value
+
+    // batch versions, one round trip for n keys or fields. values[i] are buffers of size bytes,
+    // lens[i] gets the length of each value, -1 if it doesn't exist (lens may be NULL).
+    long MGET(char** keys, uint16_t n, char** values, uint16_t size, long* lens);
+    long MSET(char** keys, char** values, uint16_t n);            // returns 1 on success
+    long HMGET(char* key, char** fields, uint16_t n, char** values, uint16_t size, long* lens);
+    long HSET(char* key, char** fields, char** values, uint16_t n); // returns the number of new fields
+    long DEL(char** keys, uint16_t n);                            // returns the number of keys deleted
+    long HGETALL(char* key, char** fields, char** values, uint16_t n, uint16_t size); // returns the number of fields
+
+    // binary versions, the value is len bytes of anything, NULs included. The reads fill buf
+    // (size bytes, no \0 added) and return the length of the value, -1 if there is none.
+    long SET(char* key, const uint8_t* value, uint16_t len);      // returns 1 on success
+    long GET(char* key, uint8_t* buf, uint16_t size);
+    long HSET(char* key, char* field, const uint8_t* value, uint16_t len);
+    long HGET(char* key, char* field, uint8_t* buf, uint16_t size);
+    long APPEND(char* key, const uint8_t* data, uint16_t len);    // returns the new length of the value
+    long LPOP(char* list, uint8_t* buf, uint16_t size);
+    long PUBLISH(char* channel, const uint8_t* data, uint16_t len); // returns the number of receivers
+
+    // streaming versions for big values
+    long SET(char* key, uint32_t len, RedisSource source, void* ctx);    // value of len bytes from source, returns 1 on success
+    long APPEND(char* key, uint32_t len, RedisSource source, void* ctx); // returns the new length of the value
+    long SETRANGE(char* key, long offset, char* value);                  // overwrite part of a value, returns the new length
+    long SETRANGE(char* key, long offset, uint32_t len, RedisSource source, void* ctx);
+    long GET(char* key, RedisSink sink, void* ctx);                      // value goes to sink, returns its length, -1 if none
+    long HGET(char* key, char* field, RedisSink sink, void* ctx);
+    long GETRANGE(char* key, long start, long end, char* buf, long sz);  // bytes start..end (inclusive), returns the length
+    long GETRANGE(char* key, long start, long end, RedisSink sink, void* ctx);
     
     // commands needing arguments using adddArg(...) and ending using end*
     long APPEND(char* list, char* buf);				  // Append a value to the end of the list
@@ -90,8 +582,31 @@ public:
               							  // ... push the LPUSH items using addArg(char*), addLongArg(long) anf addFloatArg(float).
 
     long endPUSH();                                               // Completes the startLPUSH() and startRPUSH() methods.
+
+    // Streams. XADD appends an entry, trimmed to about maxlen entries (MAXLEN ~, 0 for no
+    // trimming); in a pipeline many go out in one write. XREAD and XREADGROUP read from the
+    // streams[i] after ids[i] (">" for new entries of the group), at most count entries per
+    // stream (0 for no limit), waiting up to block_ms for one (0 waits forever, -1 doesn't
+    // block). They return the number of entries read, handed to callback one field at a time.
+    void startXADD(char* stream, long maxlen, uint16_t nfields);  // then addArg() field, value nfields times, and endXADD()
+    long endXADD(char* id, uint16_t size);                        // the new entry's ID into id (may be NULL), returns its length
+    long XADD(char* stream, long maxlen, char** fields, char** values, uint16_t n, char* id, uint16_t size);
+    long XREAD(char** streams, char** ids, uint16_t n, uint16_t count, long block_ms,
+               RedisStreamCallback callback, void* ctx);
+    long XREADGROUP(char* group, char* consumer, char** streams, char** ids, uint16_t n, uint16_t count,
+                    long block_ms, RedisStreamCallback callback, void* ctx);
+    long XACK(char* stream, char* group, char** ids, uint16_t n); // acknowledge n entries at once, returns how many were pending
+
+    // Lua scripts. startEVAL() starts an EVALSHA of script, add the numkeys keys and then the
+    // numargs arguments with addArg() and friends, and endEVAL() reads what the script returned.
+    // If REDIS doesn't have the script, it is loaded with SCRIPT LOAD and the EVALSHA sent again,
+    // one more round trip. In a pipeline or async() there is no second try, SCRIPTLOAD() first.
+    void startEVAL(RedisScript* script, uint16_t numkeys, uint16_t numargs);
+    RedisResult endEVAL(RedisReply* reply);                       // any reply, returns its type (reply may be NULL)
+    long endEVAL(char** values, uint16_t n, uint16_t size, long* lens); // a multibulk reply, like MGET
+    long SCRIPTLOAD(RedisScript* script);                         // returns 1 if REDIS has the script now
   
-    void sendArgRFMData(uint8_t header, uint8_t *data, uint8_t data_len); // format RFM12B packet
+    void sendArgRFMData(uint8_t header, uint8_t *data, uint8_t data_len); // add an RFM12B packet, header and data, as one binary argument
 };
 
 #endif
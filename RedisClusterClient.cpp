@@ -0,0 +1,303 @@
+#include "RedisClusterClient.h"
+
+// Constructor:
+// pool - RedisClients with transports of their own, pool[0] set up with the address of any
+//        node of the cluster. The others get their addresses from the slot map.
+// n - the number of connections in pool
+
+RedisClusterClient::RedisClusterClient(RedisClient** pool, uint8_t n) {
+    if (n > REDIS_CLUSTER_MAX_NODES)
+      n = REDIS_CLUSTER_MAX_NODES;
+    _poolSize = n;
+    for (uint8_t i=0; i<n; i++) {
+      _pool[i] = pool[i];
+      _pool[i]->_noteRedirects = true;
+    }
+    _nodes[0].ip = pool[0]->ip;
+    _nodes[0].port = pool[0]->port;
+    _nodeCount = 1;
+    _rangeCount = 0;
+}
+
+uint16_t RedisClusterClient::slot(const char* key) {
+    return redisKeySlot(key, strlen(key));
+}
+
+uint8_t RedisClusterClient::addNode(uint32_t ip, uint16_t port) {
+    for (uint8_t i=0; i<_nodeCount; i++) {
+      if (_nodes[i].ip == ip && _nodes[i].port == port)
+        return i;
+    }
+    if (_nodeCount == REDIS_CLUSTER_MAX_NODES)
+      return REDIS_CLUSTER_NO_NODE;
+    _nodes[_nodeCount].ip = ip;
+    _nodes[_nodeCount].port = port;
+    return _nodeCount++;
+}
+
+// The pooled connection for the node at ip:port. If that connection was talking to another
+// node it is moved over. A node that doesn't fit in the node table borrows the last one.
+
+RedisClient* RedisClusterClient::connection(uint32_t ip, uint16_t port) {
+    uint8_t i = addNode(ip, port);
+    RedisClient* r = _pool[i == REDIS_CLUSTER_NO_NODE ? _poolSize - 1 : i % _poolSize];
+
+    if (r->ip != ip || r->port != port)
+      r->connect(ip, port);
+    else
+      r->connect();
+    return r;
+}
+
+RedisClient* RedisClusterClient::nodeFor(uint16_t slot) {
+    uint16_t lo = 0;
+    uint16_t hi = _rangeCount;
+
+    // First range that ends at or after slot.
+    while (lo < hi) {
+      uint16_t mid = (lo + hi) / 2;
+      if (_ranges[mid].last < slot)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    if (lo < _rangeCount && _ranges[lo].first <= slot) {
+      RedisClusterNode* node = &_nodes[_ranges[lo].node];
+      return connection(node->ip, node->port);
+    }
+    return connection(_nodes[0].ip, _nodes[0].port);           // not in the map, the node will redirect us
+}
+
+RedisClient* RedisClusterClient::route(const char* key) {
+    if (_rangeCount == 0)
+      loadSlots();
+    return nodeFor(slot(key));
+}
+
+void RedisClusterClient::addRange(uint16_t first, uint16_t last, uint8_t node) {
+    if (_rangeCount == REDIS_CLUSTER_MAX_RANGES || first > last)
+      return;
+
+    uint16_t i = _rangeCount++;
+    while (i > 0 && _ranges[i-1].first > first) {
+      _ranges[i] = _ranges[i-1];
+      i--;
+    }
+    _ranges[i].first = first;
+    _ranges[i].last = last;
+    _ranges[i].node = node;
+}
+
+// Element handler for the CLUSTER SLOTS reply, an array of
+// [first slot, last slot, [master ip, master port, id, ...], [replica...]...].
+
+void RedisClusterClient::slotsHandler(void* ctx, const RedisElement* e) {
+    RedisClusterClient* self = (RedisClusterClient*)ctx;
+
+    if (e->depth == 2) {
+      self->_parseItem = e->index;
+      if (e->index == 0)
+        self->_parseFirst = e->integer;
+      else if (e->index == 1)
+        self->_parseLast = e->integer;
+    } else if (e->depth == 3 && self->_parseItem == 2) {
+      if (e->index == 0) {
+        // An empty or unknown address means the node we asked.
+        if (e->type != RedisResult_BULK || !redisParseIP(e->data, e->len, &self->_parseIp))
+          self->_parseIp = self->_parseFrom;
+      } else if (e->index == 1) {
+        // The slots of a master beyond the node table stay out of the map, like ranges beyond
+        // REDIS_CLUSTER_MAX_RANGES: they go to the seed node, which redirects them.
+        uint8_t node = self->addNode(self->_parseIp, e->integer);
+        if (node != REDIS_CLUSTER_NO_NODE)
+          self->addRange(self->_parseFirst, self->_parseLast, node);
+      }
+    }
+}
+
+bool RedisClusterClient::loadSlots(RedisClient* from) {
+    if (from == NULL || !from->connect())
+      return false;
+
+    from->startCmd(2, RedisCmd_CLUSTER);
+    from->addArg("SLOTS");
+    if (!from->sendCmd())
+      return false;
+
+    _rangeCount = 0;
+    _parseFrom = from->ip;
+    _parseItem = 0;
+    return from->readReply(slotsHandler, this) && _rangeCount > 0;
+}
+
+// Load the slot map, asking the known nodes in turn until one answers. Returns false
+// if none did.
+
+bool RedisClusterClient::loadSlots() {
+    for (uint8_t i=0; i<_nodeCount; i++) {
+      if (loadSlots(connection(_nodes[i].ip, _nodes[i].port)))
+        return true;
+    }
+    return false;
+}
+
+// Run cmd on the master of key. A -MOVED reply reloads the slot map and sends the command
+// again to the new master; -ASK sends ASKING and the command to the node named, once.
+// Returns what cmd returned, or 0 if the cluster kept redirecting.
+
+long RedisClusterClient::run(const char* key, RedisClusterCommand cmd, void* ctx) {
+    uint16_t s = slot(key);
+    RedisClient* r = route(key);
+    bool asking = false;
+
+    for (uint8_t tries=0; tries<=REDIS_CLUSTER_MAX_REDIRECTS; tries++) {
+      if (asking) {
+        r->startCmd(1, RedisCmd_ASKING);
+        if (r->sendCmd())
+          r->resultType();
+      }
+
+      r->_redirect.kind = RedisRedirect_NONE;
+      long rc = cmd(r, ctx);
+      RedisRedirect redirect = r->_redirect;
+      if (redirect.kind == RedisRedirect_NONE)
+        return rc;
+
+      RedisClient* next = redirect.ip ? connection(redirect.ip, redirect.port) : NULL;
+      asking = redirect.kind == RedisRedirect_ASK;
+      if (!asking) {
+        // The slot has moved for good, and likely others with it.
+        loadSlots(next);
+        if (next == NULL)
+          loadSlots();
+      }
+      r = next ? next : nodeFor(s);
+    }
+    return 0;
+}
+
+// The commands. Each one has a little function that sends it, with its arguments in a
+// ClusterArgs, so run() can send it again after a redirect.
+
+struct ClusterArgs {
+    char* key;
+    char* field;
+    char* value;
+    char* buffer;
+    long n;
+};
+
+static long sendGET(RedisClient* r, void* ctx) {
+    ClusterArgs* a = (ClusterArgs*)ctx;
+    return r->GET(a->key, a->buffer, a->n);
+}
+
+static long sendSET(RedisClient* r, void* ctx) {
+    ClusterArgs* a = (ClusterArgs*)ctx;
+    return r->SET(a->key, a->value);
+}
+
+static long sendINCR(RedisClient* r, void* ctx) {
+    return r->INCR(((ClusterArgs*)ctx)->key);
+}
+
+static long sendINCRBY(RedisClient* r, void* ctx) {
+    ClusterArgs* a = (ClusterArgs*)ctx;
+    return r->INCRBY(a->key, a->n);
+}
+
+static long sendDECR(RedisClient* r, void* ctx) {
+    return r->DECR(((ClusterArgs*)ctx)->key);
+}
+
+static long sendDEL(RedisClient* r, void* ctx) {
+    return r->DEL(((ClusterArgs*)ctx)->key);
+}
+
+static long sendEXISTS(RedisClient* r, void* ctx) {
+    return r->EXISTS(((ClusterArgs*)ctx)->key);
+}
+
+static long sendEXPIRE(RedisClient* r, void* ctx) {
+    ClusterArgs* a = (ClusterArgs*)ctx;
+    return r->EXPIRE(a->key, a->n);
+}
+
+static long sendTTL(RedisClient* r, void* ctx) {
+    return r->TTL(((ClusterArgs*)ctx)->key);
+}
+
+static long sendHGET(RedisClient* r, void* ctx) {
+    ClusterArgs* a = (ClusterArgs*)ctx;
+    return r->HGET(a->key, a->field, a->buffer, a->n);
+}
+
+static long sendHSET(RedisClient* r, void* ctx) {
+    ClusterArgs* a = (ClusterArgs*)ctx;
+    return r->HSET(a->key, a->field, a->value);
+}
+
+static long sendHDEL(RedisClient* r, void* ctx) {
+    ClusterArgs* a = (ClusterArgs*)ctx;
+    return r->HDEL(a->key, a->field);
+}
+
+long RedisClusterClient::GET(char* key, char* buffer, int buflen) {
+    ClusterArgs a = { key, NULL, NULL, buffer, buflen };
+    return run(key, sendGET, &a);
+}
+
+long RedisClusterClient::SET(char* key, char* value) {
+    ClusterArgs a = { key, NULL, value, NULL, 0 };
+    return run(key, sendSET, &a);
+}
+
+long RedisClusterClient::INCR(char* key) {
+    ClusterArgs a = { key, NULL, NULL, NULL, 0 };
+    return run(key, sendINCR, &a);
+}
+
+long RedisClusterClient::INCRBY(char* key, long by) {
+    ClusterArgs a = { key, NULL, NULL, NULL, by };
+    return run(key, sendINCRBY, &a);
+}
+
+long RedisClusterClient::DECR(char* key) {
+    ClusterArgs a = { key, NULL, NULL, NULL, 0 };
+    return run(key, sendDECR, &a);
+}
+
+long RedisClusterClient::DEL(char* key) {
+    ClusterArgs a = { key, NULL, NULL, NULL, 0 };
+    return run(key, sendDEL, &a);
+}
+
+long RedisClusterClient::EXISTS(char* key) {
+    ClusterArgs a = { key, NULL, NULL, NULL, 0 };
+    return run(key, sendEXISTS, &a);
+}
+
+long RedisClusterClient::EXPIRE(char* key, long time) {
+    ClusterArgs a = { key, NULL, NULL, NULL, time };
+    return run(key, sendEXPIRE, &a);
+}
+
+long RedisClusterClient::TTL(char* key) {
+    ClusterArgs a = { key, NULL, NULL, NULL, 0 };
+    return run(key, sendTTL, &a);
+}
+
+long RedisClusterClient::HGET(char* key, char* field, char* buffer, long sz) {
+    ClusterArgs a = { key, field, NULL, buffer, sz };
+    return run(key, sendHGET, &a);
+}
+
+long RedisClusterClient::HSET(char* key, char* field, char* value) {
+    ClusterArgs a = { key, field, value, NULL, 0 };
+    return run(key, sendHSET, &a);
+}
+
+long RedisClusterClient::HDEL(char* key, char* field) {
+    ClusterArgs a = { key, field, NULL, NULL, 0 };
+    return run(key, sendHDEL, &a);
+}
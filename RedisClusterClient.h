@@ -0,0 +1,110 @@
+#ifndef H_REDIS_CLUSTER_CLIENT
+#define H_REDIS_CLUSTER_CLIENT
+
+#include "RedisClient.h"
+#include "RedisHash.h"
+
+#ifndef REDIS_CLUSTER_MAX_NODES
+#ifdef ARDUINO
+#define REDIS_CLUSTER_MAX_NODES 4                             // master nodes remembered
+#else
+#define REDIS_CLUSTER_MAX_NODES 64
+#endif
+#endif
+
+#define REDIS_CLUSTER_NO_NODE 0xff                            // addNode() when the node table is full
+
+#ifndef REDIS_CLUSTER_MAX_RANGES
+#ifdef ARDUINO
+#define REDIS_CLUSTER_MAX_RANGES 8                            // slot ranges in the slot map
+#else
+#define REDIS_CLUSTER_MAX_RANGES 1024
+#endif
+#endif
+
+#ifndef REDIS_CLUSTER_MAX_REDIRECTS
+#define REDIS_CLUSTER_MAX_REDIRECTS 5                         // MOVED/ASK followed per command before giving up
+#endif
+
+// A master node of the cluster.
+
+struct RedisClusterNode {
+    uint32_t ip;
+    uint16_t port;
+};
+
+// Slots first..last (inclusive) are served by _nodes[node].
+
+struct RedisSlotRange {
+    uint16_t first;
+    uint16_t last;
+    uint8_t node;
+};
+
+// A command for RedisClusterClient::run(). Send it on redis, which is connected to the
+// node that holds the key, and return the result.
+
+typedef long (*RedisClusterCommand)(RedisClient* redis, void* ctx);
+
+//
+// Talks to a REDIS Cluster directly, without a proxy.
+//
+// The slot map comes from CLUSTER SLOTS and is kept as ranges of slots per master. A key
+// goes to the master of its slot, CRC16 of the key (or of its {hashtag}) modulo 16384.
+// When a node answers -MOVED the map is loaded again and the command goes to the new
+// node; -ASK sends ASKING and the command to the given node, just for that command.
+//
+// The connections come from a pool of RedisClients given to the constructor, the first one
+// set up with the address of any node of the cluster. Master i uses pool[i % n], so with one
+// RedisClient per master every node keeps its own connection.
+//
+
+class RedisClusterClient {
+private:
+    RedisClient* _pool[REDIS_CLUSTER_MAX_NODES];              // the connections
+    uint8_t _poolSize;
+    RedisClusterNode _nodes[REDIS_CLUSTER_MAX_NODES];         // masters seen so far, _nodes[0] is the seed
+    uint8_t _nodeCount;
+    RedisSlotRange _ranges[REDIS_CLUSTER_MAX_RANGES];         // the slot map, sorted by first slot
+    uint16_t _rangeCount;
+
+    // CLUSTER SLOTS parsing state
+    uint32_t _parseFrom;                                      // ip of the node asked, for entries without one
+    uint8_t _parseItem;                                       // which item of the range entry is being read
+    uint16_t _parseFirst;
+    uint16_t _parseLast;
+    uint32_t _parseIp;
+
+    uint8_t addNode(uint32_t ip, uint16_t port);              // index of the node, added if it's new and there's room
+    RedisClient* connection(uint32_t ip, uint16_t port);      // the pooled connection for a node, connected
+    RedisClient* nodeFor(uint16_t slot);                      // the connection to the master of slot
+    bool loadSlots(RedisClient* from);                        // CLUSTER SLOTS on one connection
+    void addRange(uint16_t first, uint16_t last, uint8_t node);
+    static void slotsHandler(void* ctx, const RedisElement* e);
+
+public:
+    RedisClusterClient(RedisClient** pool, uint8_t n);
+
+    bool loadSlots();                                         // (re)load the slot map from any node
+    uint16_t slot(const char* key);                           // the hash slot of key
+    RedisClient* route(const char* key);                      // the connection to the master of key
+
+    // Run cmd for key on the node that holds it, following MOVED and ASK.
+    long run(const char* key, RedisClusterCommand cmd, void* ctx);
+
+    // The common commands, with redirects followed. See RedisClient for the details.
+    long GET(char* key, char* buffer, int buflen);
+    long SET(char* key, char* value);
+    long INCR(char* key);
+    long INCRBY(char* key, long by);
+    long DECR(char* key);
+    long DEL(char* key);
+    long EXISTS(char* key);
+    long EXPIRE(char* key, long time);
+    long TTL(char* key);
+    long HGET(char* key, char* field, char* buffer, long sz);
+    long HSET(char* key, char* field, char* value);
+    long HDEL(char* key, char* field);
+};
+
+#endif
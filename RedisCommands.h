@@ -0,0 +1,85 @@
+#ifndef H_REDIS_COMMANDS
+#define H_REDIS_COMMANDS
+
+//
+// The REDIS commands the library sends, one line each: X(name, length of name, replay, queue).
+//
+// Every command starts with its name as a bulk string, "$4\r\nINCR\r\n" for INCR. These are
+// built from this table by the preprocessor and kept in flash (PROGMEM), so sending a command
+// only copies the prefix and encodes the arguments. The length is checked at compile time.
+//
+// replay is 1 for a command that may be sent a second time when its connection fails before
+// the reply is in: sending it again leaves REDIS as sending it once would (GET, SET, DEL...).
+// INCR, RPUSH, PUBLISH and the like would count twice, they are 0.
+//
+// queue is 1 for a write whose reply the caller can do without, so that it may wait in the
+// write-behind queue (RedisClient::enableQueue) while there is no connection.
+//
+// To add a command, add its line here and use RedisCmd_<name> in startCmd().
+//
+
+#define REDIS_COMMANDS(X) \
+    X(APPEND,        6, 0, 1) \
+    X(ASKING,        6, 0, 0) \
+    X(CLIENT,        6, 0, 0) \
+    X(CLUSTER,       7, 1, 0) \
+    X(DECR,          4, 0, 1) \
+    X(DECRBY,        6, 0, 1) \
+    X(DEL,           3, 1, 1) \
+    X(DISCARD,       7, 0, 0) \
+    X(EVALSHA,       7, 0, 0) \
+    X(EXEC,          4, 0, 0) \
+    X(EXISTS,        6, 1, 0) \
+    X(EXPIRE,        6, 1, 1) \
+    X(GET,           3, 1, 0) \
+    X(GETRANGE,      8, 1, 0) \
+    X(HDEL,          4, 1, 1) \
+    X(HELLO,         5, 0, 0) \
+    X(HEXISTS,       7, 1, 0) \
+    X(HGET,          4, 1, 0) \
+    X(HGETALL,       7, 1, 0) \
+    X(HINCRBY,       7, 0, 1) \
+    X(HINCRBYFLOAT, 12, 0, 1) \
+    X(HMGET,         5, 1, 0) \
+    X(HSET,          4, 1, 1) \
+    X(INCR,          4, 0, 1) \
+    X(INCRBY,        6, 0, 1) \
+    X(INCRBYFLOAT,  11, 0, 1) \
+    X(LLEN,          4, 1, 0) \
+    X(LPOP,          4, 0, 0) \
+    X(LPUSH,         5, 0, 1) \
+    X(LSET,          4, 1, 1) \
+    X(LTRIM,         5, 0, 1) \
+    X(MGET,          4, 1, 0) \
+    X(MSET,          4, 1, 1) \
+    X(MULTI,         5, 0, 0) \
+    X(PERSIST,       7, 1, 1) \
+    X(PING,          4, 1, 0) \
+    X(PSUBSCRIBE,   10, 0, 0) \
+    X(PUBLISH,       7, 0, 1) \
+    X(PUNSUBSCRIBE, 12, 0, 0) \
+    X(RPUSH,         5, 0, 1) \
+    X(SCRIPT,        6, 0, 0) \
+    X(SET,           3, 1, 1) \
+    X(SETRANGE,      8, 1, 1) \
+    X(SUBSCRIBE,     9, 0, 0) \
+    X(TIME,          4, 1, 0) \
+    X(TTL,           3, 1, 0) \
+    X(UNSUBSCRIBE,  11, 0, 0) \
+    X(UNWATCH,       7, 0, 0) \
+    X(WATCH,         5, 0, 0) \
+    X(XACK,          4, 1, 1) \
+    X(XADD,          4, 0, 1) \
+    X(XREAD,         5, 1, 0) \
+    X(XREADGROUP,   10, 0, 0)
+
+#define REDIS_COMMAND_ENUM(name, len, replay, queue) RedisCmd_##name,
+
+enum RedisCommand {
+    REDIS_COMMANDS(REDIS_COMMAND_ENUM)
+    RedisCmd_COUNT                                            // number of commands in the table
+};
+
+#undef REDIS_COMMAND_ENUM
+
+#endif
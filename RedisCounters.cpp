@@ -0,0 +1,172 @@
+#include "RedisCounters.h"
+
+#define COUNTER_MAX ((int64_t)0x7fffffffffffffffLL)           // INT64_MAX, which avr-libc keeps from C++
+#define COUNTER_MIN (-COUNTER_MAX - 1)
+
+// Constructor:
+// client - the connection the sums are sent on
+// table - n entries for the keys and hash fields being counted, the application's memory
+// interval_ms - how long a sum may wait before it is sent, 0 for as long as the table has room
+
+RedisCounters::RedisCounters(RedisClient* client, RedisCounter* table, uint8_t n, uint32_t interval_ms) {
+    _client = client;
+    _table = table;
+    _size = n;
+    _used = 0;
+    _interval = interval_ms;
+    _since = 0;
+    _stats.updates = 0;
+    _stats.commands = 0;
+    _stats.errors = 0;
+    for (uint8_t i=0; i<n; i++) {
+      table[i].key[0] = 0;
+      table[i].field[0] = 0;
+      table[i].delta = 0;
+    }
+}
+
+long RedisCounters::INCR(char* key) {
+    return add(key, "", 1);
+}
+
+long RedisCounters::INCRBY(char* key, int64_t by) {
+    return add(key, "", by);
+}
+
+long RedisCounters::DECR(char* key) {
+    return add(key, "", -1);
+}
+
+long RedisCounters::DECRBY(char* key, int64_t by) {
+    return add(key, "", -by);
+}
+
+long RedisCounters::HINCRBY(char* key, char* field, int64_t by) {
+    return add(key, field, by);
+}
+
+// Add by to the sum of key (and field), taking a free entry for a new one. The table is
+// flushed when this fills it or the oldest sum has waited long enough.
+
+long RedisCounters::add(const char* key, const char* field, int64_t by) {
+    RedisCounter* entry = NULL;
+    RedisCounter* empty = NULL;
+
+    _stats.updates++;
+    if (strlen(key) >= REDIS_COUNTER_KEY_SIZE || strlen(field) >= REDIS_COUNTER_KEY_SIZE)
+      return send(key, field, by);
+
+    for (uint8_t i=0; i<_size; i++) {
+      RedisCounter* e = &_table[i];
+      if (e->key[0] == 0) {
+        if (empty == NULL)
+          empty = e;
+      } else if (strcmp(e->key, key) == 0 && strcmp(e->field, field) == 0) {
+        entry = e;
+        break;
+      }
+    }
+
+    if (entry != NULL) {
+      if (by > 0 ? entry->delta > COUNTER_MAX - by : entry->delta < COUNTER_MIN - by)
+        return send(key, field, by);                          // the sum would wrap, REDIS adds it up instead
+      entry->delta += by;
+    } else if (empty != NULL) {
+      strcpy(empty->key, key);
+      strcpy(empty->field, field);
+      empty->delta = by;
+      if (_used++ == 0)
+        _since = millis();
+    } else {
+      return send(key, field, by);                            // full, and the last flush failed
+    }
+
+    if (_used == _size || (_interval && millis() - _since >= _interval))
+      flush();
+    return 1;
+}
+
+long RedisCounters::send(const char* key, const char* field, int64_t by) {
+    _client->connect();
+    addCmd(key, field, by);
+    if (!_client->sendCmd())
+      return 0;
+
+    _stats.commands++;
+    return _client->resultType() == RedisResult_INTEGER;
+}
+
+void RedisCounters::addCmd(const char* key, const char* field, int64_t by) {
+    if (*field) {
+      _client->startCmd(4, RedisCmd_HINCRBY);
+      _client->addArg(key);
+      _client->addArg(field);
+    } else {
+      _client->startCmd(3, RedisCmd_INCRBY);
+      _client->addArg(key);
+    }
+    _client->addInt64Arg(by);
+}
+
+// Send every waiting sum in one pipeline. Sums that added up to 0 free their entry without
+// being sent. Nothing is sent while the client is in a pipeline, an async() call or RESP2
+// Pub/Sub of its own; the sums wait for the next flush.
+
+uint16_t RedisCounters::flush() {
+    RedisClient* c = _client;
+    uint16_t done = 0;
+
+    if (_used == 0 || c->_pipelining || c->_asyncArmed || (c->_subCount > 0 && !c->_resp3))
+      return 0;
+
+    if (c->connect()) {
+      c->beginPipeline();
+      for (uint8_t i=0; i<_size; i++) {
+        if (_table[i].key[0] && _table[i].delta != 0) {
+          addCmd(_table[i].key, _table[i].field, _table[i].delta);
+          c->sendCmd();
+        }
+      }
+      uint16_t count = c->sendPipeline();
+
+      // Replies come in table order. A sum is done once its reply is in, an error included:
+      // sending it again would fail the same way.
+      for (uint8_t i=0; i<_size && done < count; i++) {
+        RedisCounter* e = &_table[i];
+        if (e->key[0] == 0 || e->delta == 0)
+          continue;
+        RedisReply reply;
+        if (!c->readReply(&reply))
+          break;
+        if (reply.type != RedisResult_INTEGER)
+          _stats.errors++;
+        e->delta = 0;
+        done++;
+      }
+      _stats.commands += done;
+    }
+
+    _used = 0;
+    for (uint8_t i=0; i<_size; i++) {
+      if (_table[i].delta == 0)
+        _table[i].key[0] = 0;
+      else
+        _used++;
+    }
+    _since = millis();                                        // what is left waits another interval
+    return done;
+}
+
+uint16_t RedisCounters::poll() {
+    if (_used == 0 || _interval == 0 || millis() - _since < _interval)
+      return 0;
+    return flush();
+}
+
+uint8_t RedisCounters::pending() {
+    return _used;
+}
+
+RedisCounterStats RedisCounters::stats() {
+    return _stats;
+}
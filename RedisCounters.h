@@ -0,0 +1,68 @@
+#ifndef H_REDIS_COUNTERS
+#define H_REDIS_COUNTERS
+
+#include "RedisClient.h"
+
+#ifndef REDIS_COUNTER_KEY_SIZE
+#define REDIS_COUNTER_KEY_SIZE 32                             // longest aggregated key or hash field + 1
+#endif
+
+// One counter of a RedisCounters table: a key, or a field of a hash, and what was added to it
+// since it was last sent. The application hands an array of these to RedisCounters, so the
+// table takes no RAM unless it is used.
+
+struct RedisCounter {
+    char key[REDIS_COUNTER_KEY_SIZE];                         // the key, empty if the entry is free
+    char field[REDIS_COUNTER_KEY_SIZE];                       // the hash field for HINCRBY, empty for INCRBY
+    int64_t delta;                                            // added up, not sent yet
+};
+
+struct RedisCounterStats {
+    uint32_t updates;                                         // INCR, INCRBY, DECR... calls
+    uint32_t commands;                                        // INCRBY and HINCRBY sent for them
+    uint32_t errors;                                          // sums REDIS refused (the key isn't a number), dropped
+};
+
+//
+// Adds up increments locally and sends each key's (or hash field's) sum as one INCRBY or
+// HINCRBY, instead of a round trip per call. All waiting sums go out in one pipeline when the
+// table is full, when the oldest has waited interval_ms, or when flush() is called. Sums are
+// exact 64 bit integers; the value REDIS holds only changes at a flush, so the commands here
+// don't return it.
+//
+// While REDIS can't be reached the sums keep adding up. If the connection fails during a
+// flush, the sums whose reply didn't come are kept and sent again, so a count can be applied
+// twice but isn't lost. A key or field too long for the table, or a new one while the table
+// is full and can't be flushed, is sent on its own through the client.
+//
+
+class RedisCounters {
+private:
+    RedisClient* _client;                                     // where the sums go
+    RedisCounter* _table;                                     // the application's entries
+    uint8_t _size;                                            // entries in _table
+    uint8_t _used;                                            // entries holding a key
+    uint32_t _interval;                                       // ms a sum may wait, 0 for no limit
+    unsigned long _since;                                     // millis() when the oldest waiting sum started
+    RedisCounterStats _stats;
+
+    long add(const char* key, const char* field, int64_t by);
+    long send(const char* key, const char* field, int64_t by); // INCRBY or HINCRBY right away
+    void addCmd(const char* key, const char* field, int64_t by); // build it in the client's command buffer
+
+public:
+    RedisCounters(RedisClient* client, RedisCounter* table, uint8_t n, uint32_t interval_ms);
+
+    long INCR(char* key);                                     // returns 1 if it was counted
+    long INCRBY(char* key, int64_t by);
+    long DECR(char* key);
+    long DECRBY(char* key, int64_t by);
+    long HINCRBY(char* key, char* field, int64_t by);
+
+    uint16_t flush();                                         // send all waiting sums now, returns how many went out
+    uint16_t poll();                                          // flush() once the interval is over, call it from loop()
+    uint8_t pending();                                        // keys and fields with a sum waiting
+    RedisCounterStats stats();                                // updates, commands sent and errors
+};
+
+#endif
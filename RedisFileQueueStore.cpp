@@ -0,0 +1,37 @@
+#ifndef ARDUINO
+
+#include "RedisFileQueueStore.h"
+
+RedisFileQueueStore::RedisFileQueueStore(const char* path) {
+   _path = path;
+}
+
+// Read the saved queue, nothing if there is no file. A queue saved by a build with a bigger
+// buffer is cut off at size bytes; RedisClient drops the command that was cut in half.
+
+uint16_t RedisFileQueueStore::load(uint8_t* buf, uint16_t size) {
+    FILE* f = fopen(_path, "rb");
+    if (f == NULL)
+      return 0;
+    size_t n = fread(buf, 1, size, f);
+    fclose(f);
+    return n;
+}
+
+bool RedisFileQueueStore::save(const uint8_t* data, uint16_t len) {
+    char tmp[256];
+
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", _path) >= (int)sizeof(tmp))
+      return false;
+    FILE* f = fopen(tmp, "wb");
+    if (f == NULL)
+      return false;
+    bool ok = fwrite(data, 1, len, f) == len;
+    if (fclose(f) != 0 || !ok) {
+      remove(tmp);
+      return false;
+    }
+    return rename(tmp, _path) == 0;
+}
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef H_REDIS_FILE_QUEUE_STORE
+#define H_REDIS_FILE_QUEUE_STORE
+
+#ifndef ARDUINO
+
+#include "RedisQueueStore.h"
+
+//
+// RedisQueueStore in a file. Every save writes the queue to path.tmp and renames it over
+// path, so a crash half way leaves the previous queue, never a torn one.
+//
+
+class RedisFileQueueStore : public RedisQueueStore {
+private:
+    const char* _path;                                        // the file, kept by the caller
+
+public:
+    RedisFileQueueStore(const char* path);
+
+    uint16_t load(uint8_t* buf, uint16_t size);
+    bool save(const uint8_t* data, uint16_t len);
+};
+
+#endif
+
+#endif
@@ -0,0 +1,360 @@
+#include "RedisFormat.h"
+
+// "00" to "99", the digits of a number are turned out two at a time.
+
+static const char digitPairs[200] PROGMEM = {
+    '0','0','0','1','0','2','0','3','0','4','0','5','0','6','0','7','0','8','0','9',
+    '1','0','1','1','1','2','1','3','1','4','1','5','1','6','1','7','1','8','1','9',
+    '2','0','2','1','2','2','2','3','2','4','2','5','2','6','2','7','2','8','2','9',
+    '3','0','3','1','3','2','3','3','3','4','3','5','3','6','3','7','3','8','3','9',
+    '4','0','4','1','4','2','4','3','4','4','4','5','4','6','4','7','4','8','4','9',
+    '5','0','5','1','5','2','5','3','5','4','5','5','5','6','5','7','5','8','5','9',
+    '6','0','6','1','6','2','6','3','6','4','6','5','6','6','6','7','6','8','6','9',
+    '7','0','7','1','7','2','7','3','7','4','7','5','7','6','7','7','7','8','7','9',
+    '8','0','8','1','8','2','8','3','8','4','8','5','8','6','8','7','8','8','8','9',
+    '9','0','9','1','9','2','9','3','9','4','9','5','9','6','9','7','9','8','9','9'
+};
+
+// Write the digits of value so they end just before end, returns where they start.
+
+static char* putDigits(uint32_t value, char* end) {
+    while (value >= 100) {
+      uint8_t i = (value % 100) * 2;
+      value /= 100;
+      end -= 2;
+      end[0] = pgm_read_byte(&digitPairs[i]);
+      end[1] = pgm_read_byte(&digitPairs[i + 1]);
+    }
+    if (value >= 10) {
+      end -= 2;
+      end[0] = pgm_read_byte(&digitPairs[value * 2]);
+      end[1] = pgm_read_byte(&digitPairs[value * 2 + 1]);
+    } else {
+      *--end = '0' + value;
+    }
+    return end;
+}
+
+// Exactly nine digits, leading zeros included, for the lower parts of a 64 bit number.
+
+static void putNine(uint32_t value, char* end) {
+    char* start = end - 9;
+    end = putDigits(value, end);
+    while (end > start)
+      *--end = '0';
+}
+
+static uint8_t countDigits(uint32_t value) {
+    uint8_t n = 1;
+    while (value >= 10000) {
+      value /= 10000;
+      n += 4;
+    }
+    return n + (value >= 10) + (value >= 100) + (value >= 1000);
+}
+
+uint8_t redisFormatUInt64(uint64_t value, char* buf) {
+    uint8_t len;
+
+    if ((value >> 32) == 0) {
+      len = countDigits(value);
+      putDigits(value, buf + len);
+    } else {
+      // At most two 64 bit divisions, the digits are all turned out in 32 bits.
+      uint64_t high = value / 1000000000UL;
+      uint32_t low = value - high * 1000000000UL;
+      if ((high >> 32) == 0) {
+        len = countDigits(high) + 9;
+        putDigits(high, buf + len - 9);
+      } else {
+        uint32_t top = high / 1000000000UL;
+        len = countDigits(top) + 18;
+        putDigits(top, buf + len - 18);
+        putNine(high - (uint64_t)top * 1000000000UL, buf + len - 9);
+      }
+      putNine(low, buf + len);
+    }
+    buf[len] = 0;
+    return len;
+}
+
+uint8_t redisFormatInt64(int64_t value, char* buf) {
+    if (value >= 0)
+      return redisFormatUInt64(value, buf);
+    *buf = '-';
+    return 1 + redisFormatUInt64(0 - (uint64_t)value, buf + 1);
+}
+
+//
+// Grisu2, after Florian Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with
+// Integers" (PLDI 2010). The number and the points halfway to its neighbours are scaled by a
+// cached power of ten into 64 bit fixed point, then digits are cut off the integer part and
+// the fraction until they can only mean this one number. No big integers and no floating
+// point arithmetic, which an AVR would have to do in software.
+//
+
+struct DiyFp {
+    uint64_t f;                                               // significand
+    int e;                                                    // binary exponent, the value is f * 2^e
+};
+
+// The upper 64 bits of the 128 bit product, rounded.
+
+static DiyFp multiply(DiyFp x, DiyFp y) {
+    const uint64_t M32 = 0xFFFFFFFFUL;
+    uint64_t a = x.f >> 32, b = x.f & M32, c = y.f >> 32, d = y.f & M32;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t mid = (bd >> 32) + (ad & M32) + (bc & M32) + (1UL << 31);
+    DiyFp r = { ac + (ad >> 32) + (bc >> 32) + (mid >> 32), x.e + y.e + 64 };
+    return r;
+}
+
+static DiyFp normalize(DiyFp x) {
+    while (!(x.f >> 63)) {
+      x.f <<= 1;
+      x.e--;
+    }
+    return x;
+}
+
+// 10^-348, 10^-340 ... 10^340, normalized.
+
+static const uint64_t cachedPowersF[] PROGMEM = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+    0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+    0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+    0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+    0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+    0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+    0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+    0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+    0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+    0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+    0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+    0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+    0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+    0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+    0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+    0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+    0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+    0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+    0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+    0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+    0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+    0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+
+static const int16_t cachedPowersE[] PROGMEM = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927, -901, -874, -847,
+    -821, -794, -768, -741, -715, -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+    -422, -396, -369, -343, -316, -289, -263, -236, -210, -183, -157, -130, -103, -77, -50,
+    -24, 3, 30, 56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667, 694, 720, 747,
+    774, 800, 827, 853, 880, 907, 933, 960, 986, 1013, 1039, 1066
+};
+
+// A power of ten 10^-k that brings a number with binary exponent e (of a normalized
+// significand) to an exponent between -60 and -32, where the integer part fits 32 bits.
+
+static DiyFp cachedPower(int e, int* k) {
+    long x = -61 - e;
+    int dk = x * 30103L / 100000L;                            // x * log10(2), rounded up
+    if (x > 0 && dk * 100000L < x * 30103L)
+      dk++;
+    uint8_t index = ((dk + 347) >> 3) + 1;
+    DiyFp c;
+
+    *k = 348 - index * 8;
+    memcpy_P(&c.f, &cachedPowersF[index], sizeof(c.f));
+    c.e = (int16_t)pgm_read_word(&cachedPowersE[index]);
+    return c;
+}
+
+static const uint32_t powersOf10[] PROGMEM = {
+    1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL, 10000000UL, 100000000UL, 1000000000UL
+};
+
+static uint32_t power10(uint8_t i) {
+    uint32_t p;
+    memcpy_P(&p, &powersOf10[i], sizeof(p));
+    return p;
+}
+
+// Step the last digit down towards the exact value as long as it stays within the interval.
+
+static void grisuRound(char* buf, uint8_t len, uint64_t delta, uint64_t rest, uint64_t tenKappa, uint64_t distance) {
+    while (rest < distance && delta - rest >= tenKappa &&
+           (rest + tenKappa < distance || distance - rest > rest + tenKappa - distance)) {
+      buf[len - 1]--;
+      rest += tenKappa;
+    }
+}
+
+// The digits of high, as few as identify a number within [high - delta, high]; w is the
+// number itself. Returns the count, *k is adjusted to their decimal exponent.
+
+static uint8_t digitGen(DiyFp w, DiyFp high, uint64_t delta, char* buf, int* k) {
+    uint8_t shift = -high.e;
+    uint64_t one = (uint64_t)1 << shift;
+    uint64_t distance = high.f - w.f;
+    uint32_t p1 = high.f >> shift;                            // integer part
+    uint64_t p2 = high.f & (one - 1);                         // fraction
+    uint8_t len = 0;
+    int8_t kappa = 10;
+
+    while (kappa > 1 && power10(kappa - 1) > p1)
+      kappa--;
+
+    while (kappa > 0) {
+      uint32_t div = power10(kappa - 1);
+      uint8_t d = p1 / div;
+      p1 -= d * div;
+      if (d || len)
+        buf[len++] = '0' + d;
+      kappa--;
+      uint64_t rest = ((uint64_t)p1 << shift) + p2;
+      if (rest <= delta) {
+        *k += kappa;
+        grisuRound(buf, len, delta, rest, (uint64_t)power10(kappa) << shift, distance);
+        return len;
+      }
+    }
+
+    while (1) {
+      p2 *= 10;
+      delta *= 10;
+      distance *= 10;
+      uint8_t d = p2 >> shift;
+      if (d || len)
+        buf[len++] = '0' + d;
+      p2 &= one - 1;
+      kappa--;
+      if (p2 < delta) {
+        *k += kappa;
+        grisuRound(buf, len, delta, p2, one, distance);
+        return len;
+      }
+    }
+}
+
+// Digits of f * 2^e that read back as it, nearly always the shortest; their value is
+// digits * 10^k. lowerCloser when f is a power of two, the next number down is then only
+// half as far away as the next one up.
+
+static uint8_t grisu2(uint64_t f, int e, bool lowerCloser, char* digits, int* k) {
+    DiyFp v = { f, e };
+    DiyFp plus = { (f << 1) + 1, e - 1 };
+    DiyFp minus = { lowerCloser ? (f << 2) - 1 : (f << 1) - 1, lowerCloser ? e - 2 : e - 1 };
+
+    plus = normalize(plus);
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+
+    DiyFp c = cachedPower(plus.e, k);
+    DiyFp w = multiply(normalize(v), c);
+    DiyFp high = multiply(plus, c);
+    DiyFp low = multiply(minus, c);
+    low.f++;
+    high.f--;
+    return digitGen(w, high, high.f - low.f, digits, k);
+}
+
+// Lay out len digits worth digits * 10^k the way %g does, but with all of them:
+// 1234.5, 0.001, 1e+21, 1.5e-07.
+
+static uint8_t layout(const char* digits, uint8_t len, int k, char* buf) {
+    int point = len + k;                                      // digits before the decimal point
+    char* p = buf;
+
+    if (point > 0 && point <= 21) {
+      for (int i=0; i<point; i++)
+        *p++ = i < len ? digits[i] : '0';
+      if (point < len) {
+        *p++ = '.';
+        memcpy(p, digits + point, len - point);
+        p += len - point;
+      }
+    } else if (point <= 0 && point > -6) {
+      *p++ = '0';
+      *p++ = '.';
+      for (int i=point; i<0; i++)
+        *p++ = '0';
+      memcpy(p, digits, len);
+      p += len;
+    } else {
+      int exp = point - 1;
+      *p++ = digits[0];
+      if (len > 1) {
+        *p++ = '.';
+        memcpy(p, digits + 1, len - 1);
+        p += len - 1;
+      }
+      *p++ = 'e';
+      *p++ = exp < 0 ? '-' : '+';
+      if (exp < 0)
+        exp = -exp;
+      if (exp >= 100) {
+        *p++ = '0' + exp / 100;
+        exp %= 100;
+      }
+      *p++ = '0' + exp / 10;
+      *p++ = '0' + exp % 10;
+    }
+    *p = 0;
+    return p - buf;
+}
+
+// An IEEE 754 number taken apart: the sign, the stored significand f and the biased
+// exponent exp, in a format with mantissaBits and exponentBits.
+
+static uint8_t formatBinary(bool neg, uint64_t f, int exp, uint8_t mantissaBits, uint8_t exponentBits, char* buf) {
+    int bias = (1 << (exponentBits - 1)) - 1 + mantissaBits;
+    char* p = buf;
+
+    if (exp == (1 << exponentBits) - 1 && f) {
+      strcpy(buf, "nan");
+      return 3;
+    }
+    if (neg)
+      *p++ = '-';
+    if (exp == (1 << exponentBits) - 1) {
+      strcpy(p, "inf");
+      return p - buf + 3;
+    }
+    if (exp == 0 && f == 0) {
+      strcpy(p, "0");
+      return p - buf + 1;
+    }
+
+    char digits[18];
+    int k;
+    uint8_t len;
+    if (exp == 0)                                             // subnormal
+      len = grisu2(f, 1 - bias, false, digits, &k);
+    else
+      len = grisu2(f | ((uint64_t)1 << mantissaBits), exp - bias, f == 0 && exp > 1, digits, &k);
+    return p - buf + layout(digits, len, k, p);
+}
+
+uint8_t redisFormatFloat(float value, char* buf) {
+    uint32_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+    return formatBinary(bits >> 31, bits & 0x7FFFFFUL, (bits >> 23) & 0xFF, 23, 8, buf);
+}
+
+uint8_t redisFormatDouble(double value, char* buf) {
+    uint64_t bits;
+
+    if (sizeof(double) == sizeof(float))                      // AVR
+      return redisFormatFloat(value, buf);
+    memcpy(&bits, &value, sizeof(bits));
+    return formatBinary(bits >> 63, bits & (((uint64_t)1 << 52) - 1), (bits >> 52) & 0x7FF, 52, 11, buf);
+}
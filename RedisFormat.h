@@ -0,0 +1,23 @@
+#ifndef H_REDIS_FORMAT
+#define H_REDIS_FORMAT
+
+#include "RedisPlatform.h"
+
+//
+// Number to text, for command arguments. Each function writes the number and a \0 into buf,
+// which must have room for REDIS_NUMBER_SIZE bytes, and returns the length of the text.
+//
+// The integer formatters work in 32 bits as far as they can and turn two digits at a time,
+// so they avoid the slow 64 bit division of an 8 bit CPU. The floating point formatters
+// write text that reads back as exactly the same number, and nearly always the shortest
+// such text (Grisu2): 0.1 is "0.1", not "0.10000000000000001" or "0.10".
+//
+
+#define REDIS_NUMBER_SIZE 26                                  // "-2.2250738585072014e-308" and its \0
+
+uint8_t redisFormatUInt64(uint64_t value, char* buf);
+uint8_t redisFormatInt64(int64_t value, char* buf);
+uint8_t redisFormatDouble(double value, char* buf);
+uint8_t redisFormatFloat(float value, char* buf);            // float precision, 0.1f is "0.1" too
+
+#endif
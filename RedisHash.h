@@ -0,0 +1,25 @@
+#ifndef H_REDIS_HASH
+#define H_REDIS_HASH
+
+#include "RedisPlatform.h"
+
+//
+// Hashing used to decide which server a key lives on. The results only depend on the bytes
+// hashed, so an Arduino and a Linux gateway sharing the same servers agree on every key.
+//
+
+// If key contains a {hashtag} with something between the braces, only that part is hashed,
+// so "user:{42}:name" and "user:{42}:mail" end up together. Returns the part to hash and
+// sets *tagLen to its length.
+const char* redisKeyTag(const char* key, uint16_t len, uint16_t* tagLen);
+
+// 32 bit FNV-1a with a final avalanche step, for the consistent hashing ring.
+uint32_t redisHash32(const void* data, uint16_t len);
+
+#define REDIS_CLUSTER_SLOTS 16384                             // hash slots of a REDIS Cluster
+
+// CRC16 as used by REDIS Cluster, and the hash slot of a key (hashtags included).
+uint16_t redisCrc16(const void* data, uint16_t len);
+uint16_t redisKeySlot(const char* key, uint16_t len);
+
+#endif
@@ -0,0 +1,317 @@
+#include "RedisParser.h"
+
+RedisParser::RedisParser() {
+   _handler = NULL;
+   _ctx = NULL;
+   _window = 0xffff;
+   reset();
+}
+
+void RedisParser::reset() {
+   _state = STATE_HEADER;
+   _bulkType = RedisResult_BULK;
+   _bulkLen = 0;
+   _bulkOff = 0;
+   _bulkHead = 0;
+   _depth = 0;
+   _attrDepth = 0;
+}
+
+void RedisParser::setHandler(RedisElementHandler handler, void* ctx) {
+   _handler = handler;
+   _ctx = ctx;
+}
+
+// Bulk strings that fit in window bytes (with their \r\n) are held back until they have
+// arrived completely, so the handler sees them in one piece. Status and error lines that
+// don't fit are cut to the window.
+
+void RedisParser::setWindow(uint16_t window) {
+   _window = window;
+}
+
+void RedisParser::emit(RedisResult type, int64_t integer, const char* data, uint16_t len, long offset) {
+    if (_handler == NULL || _attrDepth)
+      return;
+
+    RedisElement e;
+    e.type = type;
+    e.depth = _depth;
+    e.index = _depth ? _count[_depth-1] - _remaining[_depth-1] : 0;
+    e.integer = integer;
+    e.data = data;
+    e.len = len;
+    e.offset = offset;
+    _handler(_ctx, &e);
+}
+
+// Open an aggregate of count (> 0) elements, its elements are one level deeper.
+
+bool RedisParser::open(long count) {
+    if (_depth == REDIS_MAX_DEPTH)
+      return false;
+    _count[_depth] = count;
+    _remaining[_depth] = count;
+    _depth++;
+    return true;
+}
+
+// Count off one element of the innermost multibulk, closing the ones that are complete.
+// An attribute that is complete isn't an element of anything, the reply it belongs to
+// follows it.
+
+bool RedisParser::elementDone() {
+    while (_depth > 0) {
+      if (--_remaining[_depth-1] > 0)
+        return false;
+      if (_depth-- == _attrDepth) {
+        _attrDepth = 0;
+        return false;
+      }
+    }
+    return true;
+}
+
+// Parse the number in a header line, returns false if it isn't one or doesn't fit 64 bits.
+// The digits are added up in 32 bits, which is several times faster than 64 bit arithmetic
+// on an 8 bit CPU; counts, lengths and most integer replies never need more.
+
+static bool parseInteger(const char* p, const char* end, int64_t* value) {
+    bool neg = false;
+
+    if (p < end && *p == '-') {
+      neg = true;
+      p++;
+    }
+    if (p == end || end - p > 19)                             // 2^63 has 19 digits
+      return false;
+
+    // Nine digits at a time, the first chunk takes what's left over.
+    uint64_t v = 0;
+    uint8_t chunk = (end - p) % 9 ? (end - p) % 9 : 9;
+    while (p < end) {
+      uint32_t part = 0;
+      for (const char* stop = p + chunk; p < stop; p++) {
+        uint8_t d = *p - '0';
+        if (d > 9)
+          return false;
+        part = part * 10 + d;
+      }
+      v = v ? v * 1000000000UL + part : part;
+      chunk = 9;
+    }
+    if (v > ((uint64_t)1 << 63) - (neg ? 0 : 1))
+      return false;
+    *value = neg ? (int64_t)(0 - v) : (int64_t)v;
+    return true;
+}
+
+RedisParser::Status RedisParser::parse(const uint8_t* buf, uint16_t len, uint16_t* used) {
+    uint16_t pos = 0;
+
+    while (1) {
+      *used = pos;
+
+      if (_state == STATE_HEADER) {
+        const uint8_t* nl = (const uint8_t*)memchr(buf + pos, '\n', len - pos);
+        if (nl == NULL) {
+          if (len - pos < _window)
+            return PARSE_MORE;
+          if (buf[pos] != '+' && buf[pos] != '-')
+            return PARSE_ERROR;
+
+          // A status or error line that doesn't fit the window, a long error message from a
+          // script say: hand out the start of it and skip the rest.
+          const char* line = (const char*)buf + pos + 1;
+          const char* end = (const char*)buf + len;
+          if (end > line && end[-1] == '\r')
+            end--;
+          emit(buf[pos] == '+' ? RedisResult_SINGLELINE : RedisResult_ERROR, end - line, line, end - line, 0);
+          _state = STATE_LINE_REST;
+          *used = len;
+          return PARSE_MORE;
+        }
+
+        const char* line = (const char*)buf + pos + 1;
+        const char* end = (const char*)nl;
+        if (end > line && end[-1] == '\r')
+          end--;
+        char prefix = buf[pos];
+        pos = nl - buf + 1;
+        int64_t n;
+
+        switch (prefix) {
+        case '+':
+          emit(RedisResult_SINGLELINE, end - line, line, end - line, 0);
+          break;
+
+        case '-':
+          emit(RedisResult_ERROR, end - line, line, end - line, 0);
+          break;
+
+        case ':':
+          if (!parseInteger(line, end, &n))
+            return PARSE_ERROR;
+          emit(RedisResult_INTEGER, n, line, end - line, 0);
+          break;
+
+        case '$':
+        case '=':
+        case '!':
+          if (!parseInteger(line, end, &n))
+            return PARSE_ERROR;
+          if (n >= 0) {
+            _bulkType = prefix == '$' ? RedisResult_BULK : prefix == '=' ? RedisResult_VERBATIM : RedisResult_ERROR;
+            _bulkHead = prefix == '=' && n >= 4 ? 4 : 0;      // "txt:" or "mkd:"
+            _bulkLen = n;
+            _bulkOff = 0;
+            _state = STATE_BULK;
+            continue;
+          }
+          emit(RedisResult_BULK, -1, NULL, 0, 0);
+          break;
+
+        case '*':
+        case '~':
+        case '>':
+        case '%':
+          if (!parseInteger(line, end, &n))
+            return PARSE_ERROR;
+          emit(prefix == '*' ? RedisResult_MULTIBULK : prefix == '~' ? RedisResult_SET :
+               prefix == '>' ? RedisResult_PUSH : RedisResult_MAP, n, NULL, 0, 0);
+          if (n > 0) {
+            if (!open(prefix == '%' ? 2 * n : n))
+              return PARSE_ERROR;
+            continue;
+          }
+          break;
+
+        case '_':
+          emit(RedisResult_NULL, -1, NULL, 0, 0);
+          break;
+
+        case ',':
+          emit(RedisResult_DOUBLE, end - line, line, end - line, 0);
+          break;
+
+        case '(':
+          emit(RedisResult_BIGNUMBER, end - line, line, end - line, 0);
+          break;
+
+        case '#':
+          if (end - line != 1 || (*line != 't' && *line != 'f'))
+            return PARSE_ERROR;
+          emit(RedisResult_BOOLEAN, *line == 't', line, 1, 0);
+          break;
+
+        case '|':
+          // Skip the attribute, the reply it describes comes after it.
+          if (!parseInteger(line, end, &n))
+            return PARSE_ERROR;
+          if (n > 0) {
+            if (_attrDepth || !open(2 * n))
+              return PARSE_ERROR;
+            _attrDepth = _depth;
+          }
+          continue;
+
+        default:
+          return PARSE_ERROR;
+        }
+
+      } else if (_state == STATE_BULK) {
+        long remain = _bulkLen - _bulkOff;
+        uint16_t avail = len - pos;
+
+        // Small enough to arrive whole: wait for all of it rather than hand out pieces.
+        if (_bulkOff == 0 && remain + 2 <= _window && avail < remain + 2)
+          return PARSE_MORE;
+
+        uint16_t chunk = remain < avail ? remain : avail;
+        uint16_t skip = _bulkOff < _bulkHead ? _bulkHead - _bulkOff : 0;
+        if (skip > chunk)
+          skip = chunk;
+        if (chunk > skip || (chunk == remain && _bulkLen == _bulkHead))
+          emit(_bulkType, _bulkLen - _bulkHead, (const char*)buf + pos + skip, chunk - skip,
+               _bulkOff + skip - _bulkHead);
+        _bulkOff += chunk;
+        pos += chunk;
+        *used = pos;
+        if (_bulkOff < _bulkLen)
+          return PARSE_MORE;
+        _state = STATE_BULK_CRLF;
+        continue;
+
+      } else if (_state == STATE_LINE_REST) {
+        const uint8_t* nl = (const uint8_t*)memchr(buf + pos, '\n', len - pos);
+        if (nl == NULL) {
+          *used = len;
+          return PARSE_MORE;
+        }
+        pos = nl - buf + 1;
+        _state = STATE_HEADER;
+
+      } else {
+        if (len - pos < 2)
+          return PARSE_MORE;
+        pos += 2;
+        _state = STATE_HEADER;
+      }
+
+      if (elementDone()) {
+        *used = pos;
+        return PARSE_DONE;
+      }
+    }
+}
+
+void redisCopyElement(char* buf, uint16_t size, const RedisElement* e) {
+    // A piece that starts past the end: the piece before it already cut and terminated.
+    if (size == 0 || e->offset > (long)size - 1)
+      return;
+    uint16_t n = e->len;
+    if (n > size - 1 - e->offset)
+      n = size - 1 - e->offset;
+    if (n > 0)                                                // a nil has no data
+      memcpy(buf + e->offset, e->data, n);
+    buf[e->offset + n] = 0;
+}
+
+bool redisParseIP(const char* text, uint16_t len, uint32_t* ip) {
+    const char* end = text + len;
+    uint32_t value = 0;
+    uint16_t n = 0;
+    uint8_t dots = 0;
+    bool digits = false;
+
+    for (; text < end; text++) {
+      if (*text == '.' && digits && dots < 3 && n <= 255) {
+        value = (value << 8) | n;
+        n = 0;
+        dots++;
+        digits = false;
+      } else if (*text >= '0' && *text <= '9' && n < 256) {
+        n = n * 10 + (*text - '0');
+        digits = true;
+      } else {
+        return false;
+      }
+    }
+    if (dots != 3 || !digits || n > 255)
+      return false;
+    *ip = (value << 8) | n;
+    return true;
+}
+
+bool redisParseDouble(const char* text, uint16_t len, double* value) {
+    char buf[40];
+    char* end;
+
+    // strtod wants it \0 terminated. The longest REDIS sends is %.17g, about 24 bytes.
+    if (len == 0 || len >= sizeof(buf))
+      return false;
+    memcpy(buf, text, len);
+    buf[len] = 0;
+    *value = strtod(buf, &end);
+    return end == buf + len;
+}
@@ -0,0 +1,116 @@
+#ifndef H_REDIS_PARSER
+#define H_REDIS_PARSER
+
+#include "RedisPlatform.h"
+
+ enum RedisResult {
+    RedisResult_NONE,
+    RedisResult_NOTRECEIVED,
+    RedisResult_SINGLELINE,
+    RedisResult_ERROR,
+    RedisResult_INTEGER,
+    RedisResult_BULK,
+    RedisResult_MULTIBULK,
+    RedisResult_TIMEOUT,                                      // no reply before the deadline
+
+    // RESP3 (after HELLO 3)
+    RedisResult_NULL,                                         // _ the one null, integer is -1
+    RedisResult_DOUBLE,                                       // , text in data, integer is its length
+    RedisResult_BOOLEAN,                                      // # integer is 1 or 0
+    RedisResult_BIGNUMBER,                                    // ( digits in data, integer is their count
+    RedisResult_VERBATIM,                                     // = bulk string, without its "txt:" format prefix
+    RedisResult_MAP,                                          // % integer is the number of key/value pairs
+    RedisResult_SET,                                          // ~ like a multibulk
+    RedisResult_PUSH                                          // > out of band data, like a multibulk
+};
+
+#ifndef REDIS_MAX_DEPTH
+#define REDIS_MAX_DEPTH 8                                     // deepest nesting of multibulk replies
+#endif
+
+// One element of a reply as the parser walks over it. The reply itself is depth 0, the
+// elements of a multibulk are one deeper than the multibulk. data points straight into the
+// receive buffer and is only valid during the call to the handler.
+//
+// A bulk string that fits into the receive buffer is handed over in one piece. A bigger one
+// arrives in several calls, offset tells where data belongs in the whole string, and the
+// last piece ends at offset + len == integer. A status or error line that doesn't fit is
+// cut to what does, its integer is the length that was kept.
+//
+// The elements of a RESP3 map alternate between key (even index) and value (odd index).
+// Attributes (|) are skipped, the handler only sees the reply they are attached to. A blob
+// error (!) is handed over like a bulk string, but with type RedisResult_ERROR.
+
+struct RedisElement {
+    RedisResult type;                                         // the type of this element
+    uint8_t depth;                                            // 0 for the reply, 1 for its elements...
+    uint16_t index;                                           // position within the enclosing multibulk
+    int64_t integer;                                          // the integer, bulk length or multibulk count, -1 on nil
+    const char* data;                                         // text of a status, error, integer or (piece of) bulk
+    uint16_t len;                                             // bytes at data
+    long offset;                                              // position of data in the bulk string
+};
+
+typedef void (*RedisElementHandler)(void* ctx, const RedisElement* element);
+
+//
+// Incremental RESP parser. Feed it whatever bytes have arrived; it consumes as much as it can
+// and remembers where it stopped, so a reply can be split anywhere between network reads.
+// Lines are found with memchr and bulk strings are passed on without being copied.
+//
+
+class RedisParser {
+public:
+    enum Status {
+      PARSE_MORE,                                             // need more bytes to finish the reply
+      PARSE_DONE,                                             // a complete reply was parsed
+      PARSE_ERROR                                             // the stream is not valid RESP
+    };
+
+    RedisParser();
+
+    void reset();                                             // forget any partial reply
+    void setHandler(RedisElementHandler handler, void* ctx);  // who gets the elements
+    void setWindow(uint16_t window);                          // size of the caller's receive buffer
+
+    // Parse from buf[0..len). *used is set to the number of bytes consumed; the caller drops
+    // those and calls again with more data appended to the rest. Stops after one reply.
+    Status parse(const uint8_t* buf, uint16_t len, uint16_t* used);
+
+private:
+    enum State { STATE_HEADER, STATE_BULK, STATE_BULK_CRLF, STATE_LINE_REST };
+
+    RedisElementHandler _handler;
+    void* _ctx;
+    uint16_t _window;                                         // bulk strings up to this size arrive whole
+    State _state;
+    RedisResult _bulkType;                                    // BULK, VERBATIM or ERROR (a blob error)
+    long _bulkLen;                                            // length of the bulk being read
+    long _bulkOff;                                            // bytes of it passed on so far
+    uint8_t _bulkHead;                                        // bytes at its start that aren't passed on
+    uint8_t _depth;                                           // number of open multibulks
+    uint8_t _attrDepth;                                       // _depth of an attribute being skipped, 0 if none
+    long _count[REDIS_MAX_DEPTH];                             // element count of each open multibulk
+    long _remaining[REDIS_MAX_DEPTH];                         // elements still to come in each
+
+    void emit(RedisResult type, int64_t integer, const char* data, uint16_t len, long offset);
+    bool open(long count);                                    // start a multibulk, map, set or push of count elements
+    bool elementDone();                                       // true when the whole reply is complete
+};
+
+// Copy the text of e to buf of size bytes, for a piece of a bulk string to its place at
+// e->offset. What doesn't fit is cut off, and buf is always \0 terminated within size.
+
+void redisCopyElement(char* buf, uint16_t size, const RedisElement* e);
+
+// Parse the text of an IPv4 address, "a.b.c.d", as REDIS puts it into MOVED and ASK
+// errors and CLUSTER SLOTS replies. Returns false if it isn't one.
+
+bool redisParseIP(const char* text, uint16_t len, uint32_t* ip);
+
+// Parse the text of a RESP3 double, including "inf", "-inf" and "nan". Returns false if it
+// isn't one.
+
+bool redisParseDouble(const char* text, uint16_t len, double* value);
+
+#endif
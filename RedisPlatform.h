@@ -0,0 +1,57 @@
+#ifndef H_REDIS_PLATFORM
+#define H_REDIS_PLATFORM
+
+//
+// Platform glue. On an Arduino this just pulls in Arduino.h. On a host (Linux, macOS) it provides
+// the handful of Arduino runtime functions the library uses, so the same RedisClient code can be
+// compiled with g++ and run against a real redis-server.
+//
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+
+#else
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Milliseconds since the first call, like the Arduino millis().
+
+static inline unsigned long millis() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)(ts.tv_sec * 1000UL + ts.tv_nsec / 1000000UL);
+}
+
+// Microseconds, like the Arduino micros().
+
+static inline unsigned long micros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)(ts.tv_sec * 1000000UL + ts.tv_nsec / 1000UL);
+}
+
+static inline void delay(unsigned long ms) {
+    usleep(ms * 1000);
+}
+
+static inline void yield() {
+}
+
+// Flash storage is only a thing on AVR, on a host PROGMEM data is ordinary memory.
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+#define pgm_read_ptr(addr) (*(const void* const*)(addr))
+#define memcpy_P memcpy
+#define memcmp_P memcmp
+
+#endif
+
+#endif
@@ -0,0 +1,172 @@
+#ifndef ARDUINO
+
+#include "RedisPosixTransport.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <poll.h>
+
+RedisPosixTransport::RedisPosixTransport() {
+   _fd = -1;
+   _rpos = 0;
+   _rlen = 0;
+}
+
+RedisPosixTransport::~RedisPosixTransport() {
+   close();
+}
+
+uint32_t RedisPosixTransport::IP2U32(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+   return ((uint32_t)a << 24) | ((uint32_t)b << 16) | ((uint32_t)c << 8) | d;
+}
+
+bool RedisPosixTransport::connect(uint32_t ip, uint16_t port) {
+    close();
+
+    _fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (_fd < 0)
+      return false;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(ip);
+
+    if (::connect(_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+      close();
+      return false;
+    }
+
+    // Commands are small and latency bound, don't let Nagle hold them back.
+    int one = 1;
+    setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return true;
+}
+
+uint32_t RedisPosixTransport::resolve(const char* host) {
+    struct addrinfo hints;
+    struct addrinfo* res = NULL;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, NULL, &hints, &res) != 0 || res == NULL)
+      return 0;
+
+    uint32_t ip = ntohl(((struct sockaddr_in*)res->ai_addr)->sin_addr.s_addr);
+    freeaddrinfo(res);
+    return ip;
+}
+
+bool RedisPosixTransport::connect(const char* host, uint16_t port) {
+    uint32_t ip = resolve(host);
+    if (ip == 0)
+      return false;
+    return connect(ip, port);
+}
+
+bool RedisPosixTransport::connected() {
+    return _fd >= 0;
+}
+
+void RedisPosixTransport::close() {
+    if (_fd >= 0)
+      ::close(_fd);
+    _fd = -1;
+    _rpos = 0;
+    _rlen = 0;
+}
+
+// Write all of buf, returns len, or -1 if the connection failed.
+
+int RedisPosixTransport::write(const uint8_t *buf, uint16_t len) {
+    uint16_t sent = 0;
+
+    if (_fd < 0)
+      return -1;
+
+    while (sent < len) {
+      ssize_t rc = send(_fd, buf + sent, len - sent, MSG_NOSIGNAL);
+      if (rc < 0) {
+        if (errno == EINTR)
+          continue;
+        close();
+        return -1;
+      }
+      sent += rc;
+    }
+    return len;
+}
+
+// Pull whatever the socket has right now into the receive buffer without blocking.
+// Returns the number of buffered bytes.
+
+int RedisPosixTransport::fill() {
+    if (_rpos < _rlen)
+      return _rlen - _rpos;
+    if (_fd < 0)
+      return 0;
+
+    _rpos = 0;
+    _rlen = 0;
+    ssize_t rc = recv(_fd, _rbuf, sizeof(_rbuf), MSG_DONTWAIT);
+    if (rc > 0) {
+      _rlen = rc;
+    } else if (rc == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+      close();                                                // peer closed or socket error
+    }
+    return _rlen;
+}
+
+int RedisPosixTransport::available() {
+    return fill();
+}
+
+int RedisPosixTransport::read() {
+    if (!fill())
+      return -1;
+    return _rbuf[_rpos++];
+}
+
+int RedisPosixTransport::read(uint8_t *buf, uint16_t len) {
+    if (_rpos < _rlen) {
+      int n = _rlen - _rpos;
+      if (n > len)
+        n = len;
+      memcpy(buf, _rbuf + _rpos, n);
+      _rpos += n;
+      return n;
+    }
+    if (_fd < 0)
+      return 0;
+
+    ssize_t rc = recv(_fd, buf, len, MSG_DONTWAIT);
+    if (rc > 0)
+      return rc;
+    if (rc == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+      close();
+    return 0;
+}
+
+bool RedisPosixTransport::waitAvailable(uint32_t timeout_ms) {
+    if (_rpos < _rlen)
+      return true;
+    if (_fd < 0)
+      return false;
+
+    struct pollfd pfd;
+    pfd.fd = _fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, timeout_ms > 0x7fffffff ? -1 : (int)timeout_ms) <= 0)
+      return false;
+    return fill() > 0;
+}
+
+#endif
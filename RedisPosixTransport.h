@@ -0,0 +1,51 @@
+#ifndef H_REDIS_POSIX_TRANSPORT
+#define H_REDIS_POSIX_TRANSPORT
+
+#ifndef ARDUINO
+
+#include "RedisTransport.h"
+
+#ifndef REDIS_POSIX_READ_BUF_SIZE
+#define REDIS_POSIX_READ_BUF_SIZE 4096
+#endif
+
+//
+// RedisTransport on top of BSD sockets, for running RedisClient on Linux gateways or for
+// profiling the command code off-device. Nagle is switched off (TCP_NODELAY) since every
+// command is one small write followed by a wait for the reply. Single byte reads are
+// buffered, so they cost a memory access, not a system call; block reads go straight to the
+// socket once the buffer is empty. waitAvailable() sleeps in poll().
+//
+
+class RedisPosixTransport : public RedisTransport {
+private:
+    int _fd;                                                  // the socket, -1 when closed
+    uint8_t _rbuf[REDIS_POSIX_READ_BUF_SIZE];                 // receive buffer
+    uint16_t _rpos;                                           // next unread byte in _rbuf
+    uint16_t _rlen;                                           // number of valid bytes in _rbuf
+
+    int fill();                                               // pull what the socket has into _rbuf
+
+public:
+    RedisPosixTransport();
+    ~RedisPosixTransport();
+
+    // Same byte order as Adafruit_CC3000::IP2U32, so addresses are written the same way on both.
+    static uint32_t IP2U32(uint8_t a, uint8_t b, uint8_t c, uint8_t d);
+    static uint32_t resolve(const char* host);                // host name to address, 0 if unknown
+
+    bool connect(uint32_t ip, uint16_t port);
+    bool connect(const char* host, uint16_t port);            // resolve host name, then connect
+    bool connected();
+    void close();
+
+    int write(const uint8_t *buf, uint16_t len);
+    int available();
+    int read();
+    int read(uint8_t *buf, uint16_t len);
+    bool waitAvailable(uint32_t timeout_ms);
+};
+
+#endif
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef H_REDIS_QUEUE_STORE
+#define H_REDIS_QUEUE_STORE
+
+#include "RedisPlatform.h"
+
+//
+// Keeps a copy of the write-behind queue (RedisClient::enableQueue) where it survives a
+// reset: a file, EEPROM, a flash page. The queue is a plain run of RESP commands, exactly the
+// bytes that will be written to REDIS, so a store only has to keep bytes:
+//
+//   RedisFileQueueStore - a file, written to a temporary and renamed over it (not Arduino)
+//
+// save() is called every time the queue changes, with all of it. A store on flash that wears
+// out may well decide to write only every so often, or only the new bytes at the end; what it
+// doesn't save is lost by a reset, but never by a network outage.
+//
+
+class RedisQueueStore {
+public:
+    virtual ~RedisQueueStore() {}
+
+    virtual uint16_t load(uint8_t* buf, uint16_t size) = 0;    // read the saved queue into buf, returns its length
+    virtual bool save(const uint8_t* data, uint16_t len) = 0; // replace the saved queue with len bytes at data
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include "RedisSha1.h"
+
+// FIPS 180-1. The message schedule is kept as a ring of 16 words instead of 80, on an
+// Arduino that is the difference between 64 and 320 bytes of stack.
+
+static uint32_t rol(uint32_t x, uint8_t n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+static void sha1Block(uint32_t* h, const uint8_t* block) {
+    uint32_t w[16];
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+    for (uint8_t i=0; i<16; i++)
+      w[i] = (uint32_t)block[i*4] << 24 | (uint32_t)block[i*4+1] << 16 |
+             (uint32_t)block[i*4+2] << 8 | block[i*4+3];
+
+    for (uint8_t i=0; i<80; i++) {
+      uint32_t f, k;
+
+      if (i >= 16)
+        w[i & 15] = rol(w[(i+13) & 15] ^ w[(i+8) & 15] ^ w[(i+2) & 15] ^ w[i & 15], 1);
+      if (i < 20) {
+        f = (b & c) | (~b & d);
+        k = 0x5a827999UL;
+      } else if (i < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ed9eba1UL;
+      } else if (i < 60) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8f1bbcdcUL;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xca62c1d6UL;
+      }
+      uint32_t t = rol(a, 5) + f + e + k + w[i & 15];
+      e = d;
+      d = c;
+      c = rol(b, 30);
+      b = a;
+      a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+void redisSha1Hex(const void* data, uint32_t len, char* hex) {
+    const uint8_t* p = (const uint8_t*)data;
+    uint32_t h[5] = {0x67452301UL, 0xefcdab89UL, 0x98badcfeUL, 0x10325476UL, 0xc3d2e1f0UL};
+    uint8_t block[64];
+    uint32_t left = len;
+
+    for (; left >= 64; left -= 64, p += 64)
+      sha1Block(h, p);
+
+    // The last bytes, a 1 bit, zeros and the length in bits, in one block or two.
+    memset(block, 0, sizeof(block));
+    memcpy(block, p, left);
+    block[left] = 0x80;
+    if (left >= 56) {
+      sha1Block(h, block);
+      memset(block, 0, sizeof(block));
+    }
+    uint64_t bits = (uint64_t)len * 8;
+    for (uint8_t i=0; i<8; i++)
+      block[63 - i] = bits >> (i * 8);
+    sha1Block(h, block);
+
+    static const char digits[] PROGMEM = "0123456789abcdef";
+    for (uint8_t i=0; i<40; i++)
+      hex[i] = pgm_read_byte(&digits[(h[i / 8] >> (28 - (i % 8) * 4)) & 15]);
+    hex[40] = 0;
+}
@@ -0,0 +1,17 @@
+#ifndef H_REDIS_SHA1
+#define H_REDIS_SHA1
+
+#include "RedisPlatform.h"
+
+//
+// SHA1, for the name REDIS knows a Lua script by (EVALSHA, SCRIPT LOAD). Computed here so the
+// script itself only has to be sent when REDIS doesn't have it yet. Takes about 100 bytes
+// of stack and no RAM beyond that.
+//
+
+#define REDIS_SHA1_HEX_SIZE 41                                // 40 hex digits and \0
+
+// The SHA1 of len bytes at data, as 40 lower case hex digits and a \0 in hex.
+void redisSha1Hex(const void* data, uint32_t len, char* hex);
+
+#endif
@@ -0,0 +1,287 @@
+#include "RedisShardedClient.h"
+
+// Constructor:
+// shards - a RedisClient for each server, each with its own transport
+// n - the number of servers, at most REDIS_MAX_SHARDS
+
+RedisShardedClient::RedisShardedClient(RedisClient** shards, uint8_t n) {
+    uint8_t point[8];
+
+    if (n > REDIS_MAX_SHARDS)
+      n = REDIS_MAX_SHARDS;
+    _count = n;
+    _points = 0;
+    _pipelining = false;
+    _queued = 0;
+
+    // The points of a server come from its address, not its position in shards[], so the
+    // order the servers are listed in doesn't matter.
+    for (uint8_t s=0; s<n; s++) {
+      _shards[s] = shards[s];
+      uint32_t ip = shards[s]->ip;
+      uint16_t port = shards[s]->port;
+
+      for (uint16_t v=0; v<REDIS_SHARD_VNODES; v++) {
+        point[0] = ip >> 24;
+        point[1] = ip >> 16;
+        point[2] = ip >> 8;
+        point[3] = ip;
+        point[4] = port >> 8;
+        point[5] = port;
+        point[6] = v >> 8;
+        point[7] = v;
+
+        // Insertion sort, the ring is only built once.
+        RedisShardPoint p;
+        p.hash = redisHash32(point, sizeof(point));
+        p.shard = s;
+        uint16_t i = _points++;
+        while (i > 0 && _ring[i-1].hash > p.hash) {
+          _ring[i] = _ring[i-1];
+          i--;
+        }
+        _ring[i] = p;
+      }
+    }
+}
+
+uint8_t RedisShardedClient::shardOf(const char* key) {
+    uint16_t len;
+    const char* tag = redisKeyTag(key, strlen(key), &len);
+    uint32_t hash = redisHash32(tag, len);
+
+    // First point at or after hash, wrapping around to the first.
+    uint16_t lo = 0;
+    uint16_t hi = _points;
+    while (lo < hi) {
+      uint16_t mid = (lo + hi) / 2;
+      if (_ring[mid].hash < hash)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    if (lo == _points)
+      lo = 0;
+    return _ring[lo].shard;
+}
+
+// Returns the connection to the server key lives on. In a pipeline, call it once for each
+// command queued, that's how the replies are put back in order.
+
+RedisClient* RedisShardedClient::shard(const char* key) {
+    uint8_t s = shardOf(key);
+
+    if (_pipelining) {
+      if (_queued < REDIS_SHARD_MAX_PIPELINE)
+        _order[_queued] = s;
+      _queued++;
+    }
+    return _shards[s];
+}
+
+uint8_t RedisShardedClient::shards() {
+    return _count;
+}
+
+RedisClient* RedisShardedClient::shardAt(uint8_t i) {
+    return i < _count ? _shards[i] : NULL;
+}
+
+// Count the keys for each server into counts[], returns the number of servers involved.
+
+uint16_t RedisShardedClient::countPerShard(char** keys, uint16_t n, uint16_t* counts) {
+    uint16_t used = 0;
+
+    for (uint8_t s=0; s<_count; s++)
+      counts[s] = 0;
+    for (uint16_t i=0; i<n; i++) {
+      if (counts[shardOf(keys[i])]++ == 0)
+        used++;
+    }
+    return used;
+}
+
+struct ShardArrayTarget {
+    RedisShardedClient* self;
+    char** keys;                                              // all the keys of the MGET
+    uint16_t n;
+    char** values;                                            // one buffer per key
+    uint16_t size;                                            // size of each buffer
+    long* lens;                                               // length of each value, may be NULL
+    uint8_t shard;                                            // the server this reply is from
+    uint16_t key;                                             // index in keys of the current element
+    long element;                                             // index of the current element in the reply
+};
+
+// Element handler for the MGET reply of one server. Its elements belong to the keys of that
+// server, in order, so they are put back in their place in values[].
+
+void RedisShardedClient::mgetHandler(void* ctx, const RedisElement* e) {
+    ShardArrayTarget* t = (ShardArrayTarget*)ctx;
+
+    if (e->depth != 1)
+      return;
+
+    if (e->index != t->element) {
+      t->element = e->index;
+      t->key = t->element == 0 ? 0 : t->key + 1;
+      while (t->key < t->n && t->self->shardOf(t->keys[t->key]) != t->shard)
+        t->key++;
+    }
+    if (t->key >= t->n)
+      return;
+
+    if (t->lens)
+      t->lens[t->key] = e->integer;
+    redisCopyElement(t->values[t->key], t->size, e);
+}
+
+// Get the values of n keys from wherever they live. values[i] (size bytes each) gets the
+// value of keys[i], lens[i] its length or -1 if it doesn't exist; lens may be NULL. Returns
+// the number of values read.
+
+long RedisShardedClient::MGET(char** keys, uint16_t n, char** values, uint16_t size, long* lens) {
+    uint16_t counts[REDIS_MAX_SHARDS];
+    bool sent[REDIS_MAX_SHARDS];
+    long total = 0;
+
+    for (uint16_t i=0; i<n; i++) {
+      if (size)
+        values[i][0] = 0;
+      if (lens)
+        lens[i] = -1;
+    }
+    countPerShard(keys, n, counts);
+
+    for (uint8_t s=0; s<_count; s++) {
+      RedisClient* r = _shards[s];
+      sent[s] = false;
+      if (counts[s] == 0)
+        continue;
+      r->connect();
+      r->startCmd(counts[s] + 1, RedisCmd_MGET);
+      for (uint16_t i=0; i<n; i++) {
+        if (shardOf(keys[i]) == s)
+          r->addArg(keys[i]);
+      }
+      sent[s] = r->sendCmd();
+    }
+
+    for (uint8_t s=0; s<_count; s++) {
+      if (!sent[s])
+        continue;
+      ShardArrayTarget t;
+      t.self = this;
+      t.keys = keys;
+      t.n = n;
+      t.values = values;
+      t.size = size;
+      t.lens = lens;
+      t.shard = s;
+      t.key = 0;
+      t.element = -1;
+      if (_shards[s]->readReply(mgetHandler, &t))
+        total += counts[s];
+    }
+    return total;
+}
+
+// Set n keys to their values, each on its server. Returns 1 if all servers said OK.
+
+long RedisShardedClient::MSET(char** keys, char** values, uint16_t n) {
+    uint16_t counts[REDIS_MAX_SHARDS];
+    bool sent[REDIS_MAX_SHARDS];
+    long ok = 1;
+
+    countPerShard(keys, n, counts);
+
+    for (uint8_t s=0; s<_count; s++) {
+      RedisClient* r = _shards[s];
+      sent[s] = false;
+      if (counts[s] == 0)
+        continue;
+      r->connect();
+      r->startCmd(2 * counts[s] + 1, RedisCmd_MSET);
+      for (uint16_t i=0; i<n; i++) {
+        if (shardOf(keys[i]) == s) {
+          r->addArg(keys[i]);
+          r->addArg(values[i]);
+        }
+      }
+      sent[s] = r->sendCmd();
+      if (!sent[s])
+        ok = 0;
+    }
+
+    for (uint8_t s=0; s<_count; s++) {
+      if (sent[s] && _shards[s]->resultType() != RedisResult_SINGLELINE)
+        ok = 0;
+    }
+    return ok;
+}
+
+// Delete n keys, each on its server. Returns the number of keys that existed.
+
+long RedisShardedClient::DEL(char** keys, uint16_t n) {
+    uint16_t counts[REDIS_MAX_SHARDS];
+    bool sent[REDIS_MAX_SHARDS];
+    long deleted = 0;
+
+    countPerShard(keys, n, counts);
+
+    for (uint8_t s=0; s<_count; s++) {
+      RedisClient* r = _shards[s];
+      sent[s] = false;
+      if (counts[s] == 0)
+        continue;
+      r->connect();
+      r->startCmd(counts[s] + 1, RedisCmd_DEL);
+      for (uint16_t i=0; i<n; i++) {
+        if (shardOf(keys[i]) == s)
+          r->addArg(keys[i]);
+      }
+      sent[s] = r->sendCmd();
+    }
+
+    for (uint8_t s=0; s<_count; s++) {
+      if (sent[s])
+        deleted += _shards[s]->readInt();
+    }
+    return deleted;
+}
+
+// Start queueing commands on all servers.
+
+void RedisShardedClient::beginPipeline() {
+    for (uint8_t s=0; s<_count; s++)
+      _shards[s]->beginPipeline();
+    _pipelining = true;
+    _queued = 0;
+}
+
+// Send every server its queue, then read the replies in the order the commands were queued.
+// Only the first REDIS_SHARD_MAX_PIPELINE commands have their order recorded, replies to the
+// commands after those are read and thrown away. Returns the number of commands queued.
+
+uint16_t RedisShardedClient::execPipeline(RedisReply* replies, uint16_t n) {
+    uint16_t left[REDIS_MAX_SHARDS];
+    uint16_t queued = _queued;
+
+    _pipelining = false;
+    _queued = 0;
+    for (uint8_t s=0; s<_count; s++)
+      left[s] = _shards[s]->sendPipeline();
+
+    for (uint16_t i=0; i<queued && i<REDIS_SHARD_MAX_PIPELINE; i++) {
+      uint8_t s = _order[i];
+      if (left[s] == 0)
+        continue;
+      left[s]--;
+      _shards[s]->readReply(i < n ? &replies[i] : NULL);
+    }
+    for (uint8_t s=0; s<_count; s++) {
+      while (left[s]-- > 0)
+        _shards[s]->readReply((RedisReply*)NULL);
+    }
+    return queued;
+}
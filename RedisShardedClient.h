@@ -0,0 +1,77 @@
+#ifndef H_REDIS_SHARDED_CLIENT
+#define H_REDIS_SHARDED_CLIENT
+
+#include "RedisClient.h"
+#include "RedisHash.h"
+
+#ifndef REDIS_MAX_SHARDS
+#ifdef ARDUINO
+#define REDIS_MAX_SHARDS 2                                    // servers a RedisShardedClient can spread keys over
+#else
+#define REDIS_MAX_SHARDS 16
+#endif
+#endif
+
+#ifndef REDIS_SHARD_VNODES
+#define REDIS_SHARD_VNODES 32                                 // points per server on the ring, must be the same for all clients
+#endif
+
+#ifndef REDIS_SHARD_MAX_PIPELINE
+#ifdef ARDUINO
+#define REDIS_SHARD_MAX_PIPELINE 32                           // pipelined commands whose replies are handed back
+#else
+#define REDIS_SHARD_MAX_PIPELINE 4096
+#endif
+#endif
+
+// A point on the consistent hashing ring.
+
+struct RedisShardPoint {
+    uint32_t hash;                                            // position on the ring
+    uint8_t shard;                                            // the server that owns the keys up to here
+};
+
+//
+// Spreads keys over several REDIS servers, each reached through its own RedisClient.
+//
+// Keys are placed by consistent hashing: every server gets REDIS_SHARD_VNODES points on a
+// ring, derived from its address, and a key belongs to the first point at or after its own
+// hash. Adding or removing a server only moves the keys next to its points. Only the
+// {hashtag} of a key is hashed if it has one, so related keys can be kept on one server.
+//
+// Single key commands go through shard(key). The batch commands and the pipeline are split
+// per server; all servers get their part before any reply is read, so they work in parallel.
+//
+
+class RedisShardedClient {
+private:
+    RedisClient* _shards[REDIS_MAX_SHARDS];                   // one connection per server
+    uint8_t _count;                                           // number of servers
+    RedisShardPoint _ring[REDIS_MAX_SHARDS * REDIS_SHARD_VNODES]; // sorted by hash
+    uint16_t _points;                                         // points used in _ring
+    bool _pipelining;                                         // commands are being queued
+    uint8_t _order[REDIS_SHARD_MAX_PIPELINE];                 // server of each queued command
+    uint16_t _queued;                                         // commands queued (only the first ones are in _order)
+
+    uint8_t shardOf(const char* key);                         // index of the server for key
+    uint16_t countPerShard(char** keys, uint16_t n, uint16_t* counts);
+    static void mgetHandler(void* ctx, const RedisElement* e);
+
+public:
+    RedisShardedClient(RedisClient** shards, uint8_t n);
+
+    RedisClient* shard(const char* key);                      // the connection to use for key
+    uint8_t shards();                                         // number of servers
+    RedisClient* shardAt(uint8_t i);                          // the connection to server i
+
+    // Batch commands, split per server and sent to all of them before waiting for a reply.
+    long MGET(char** keys, uint16_t n, char** values, uint16_t size, long* lens);
+    long MSET(char** keys, char** values, uint16_t n);        // returns 1 if all servers succeeded
+    long DEL(char** keys, uint16_t n);                        // returns the number of keys deleted
+
+    // Pipelining: queue commands with shard(key)->COMMAND(...), one shard() call per command.
+    void beginPipeline();
+    uint16_t execPipeline(RedisReply* replies, uint16_t n);   // replies in the order the commands were queued
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef H_REDIS_TRANSPORT
+#define H_REDIS_TRANSPORT
+
+#include "RedisPlatform.h"
+
+//
+// The network layer used by RedisClient. RedisClient only ever talks to the REDIS server through
+// these few calls, so any TCP stack can be plugged in underneath it:
+//
+//   RedisCC3000Transport - the Adafruit CC3000 WiFi breakout (Arduino)
+//   RedisPosixTransport  - BSD sockets (Linux, macOS), for gateways and for profiling off-device
+//
+// The semantics follow the Arduino Client class: read() and available() never block, read()
+// returns -1 when there is nothing to read. waitAvailable() is the only call that blocks; the
+// default polls available(), a transport that can sleep on its socket should override it.
+//
+
+class RedisTransport {
+public:
+    virtual ~RedisTransport() {}
+
+    virtual bool connect(uint32_t ip, uint16_t port) = 0;     // open a TCP connection to ip:port
+    virtual bool connected() = 0;                             // is the connection still open
+    virtual void close() = 0;                                 // close the connection
+
+    virtual int write(const uint8_t *buf, uint16_t len) = 0;  // returns bytes written, -1 on error
+    virtual int available() = 0;                              // number of bytes that can be read now
+    virtual int read() = 0;                                   // read one byte, -1 if none available
+    virtual int read(uint8_t *buf, uint16_t len) = 0;         // read up to len bytes, returns count read
+
+    // Wait up to timeout_ms for data, returns true if there is something to read.
+    virtual bool waitAvailable(uint32_t timeout_ms) {
+        unsigned long start = millis();
+        while (!available()) {
+          if (!connected() || millis() - start >= timeout_ms)
+            return false;
+          yield();
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,422 @@
+//
+// Host (Linux/macOS) benchmark of RedisClient, in the spirit of redis-benchmark. Each test runs
+// one command n times, alone or in pipelines, and reports throughput and the p50/p99/p999
+// latency of each round trip:
+//
+//   GET, SET   with 16, 256 and 4096 byte values
+//   INCR
+//   HSET       of 1 and 8 fields
+//   RPUSH      of 1, 10 and 100 items
+//   and SET, GET, INCR and RPUSH again in pipelines of 16 and 100 commands
+//
+// Without a host it runs against FakeRedis, a RESP stand-in that lives in the same process
+// and answers in write(). Then there is no network and no server in the numbers, only the
+// client encoding the commands and parsing the replies, and two runs on the same machine give
+// the same results: that is the one to track regressions with. With a host it measures the
+// real thing against a redis-server.
+//
+// -j prints one JSON object per test instead of the table, for scripts to collect.
+//
+// Build from the library folder:
+//
+//   g++ -O2 -I. RedisClient.cpp RedisParser.cpp RedisFormat.cpp RedisSha1.cpp RedisPosixTransport.cpp examples/HostBench/HostBench.cpp -o hostbench
+//   ./hostbench [-j] [-n ops] [host [port]]
+//
+// Add -DREDIS_STATS=0 to leave the stats out of the numbers.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "RedisClient.h"
+
+//
+// FakeRedis: a RedisTransport that is its own server. The commands written to it are parsed
+// as they come and the replies queued for read(), so they are there before the client asks.
+// It knows just what the benchmark sends, on a handful of keys.
+//
+
+#define FAKE_KEYS 16
+#define FAKE_ARGS 256
+
+struct FakeKey {
+  char name[32];
+  char* value;                                                // string value, NULL if none
+  long len;
+  long long number;                                           // INCR counter, list length
+};
+
+class FakeRedis : public RedisTransport {
+private:
+  bool _open;
+  uint8_t* _in;                                               // bytes written, not a whole command yet
+  long _inLen, _inSize;
+  uint8_t* _out;                                              // replies not read yet
+  long _outPos, _outLen, _outSize;
+  FakeKey _keys[FAKE_KEYS];
+
+  static void grow(uint8_t** buf, long* size, long need) {
+    if (need <= *size)
+      return;
+    while (*size < need)
+      *size = *size ? *size * 2 : 4096;
+    *buf = (uint8_t*)realloc(*buf, *size);
+  }
+
+  void reply(const char* data, long len) {
+    if (_outPos == _outLen)
+      _outPos = _outLen = 0;
+    grow(&_out, &_outSize, _outLen + len);
+    memcpy(_out + _outLen, data, len);
+    _outLen += len;
+  }
+
+  void replyInt(long long n) {
+    char line[32];
+    reply(line, snprintf(line, sizeof(line), ":%lld\r\n", n));
+  }
+
+  FakeKey* key(const uint8_t* name, long len, bool create) {
+    FakeKey* free = NULL;
+    for (int i = 0; i < FAKE_KEYS; i++) {
+      if (_keys[i].name[0] == 0) {
+        if (free == NULL)
+          free = &_keys[i];
+      } else if ((long)strlen(_keys[i].name) == len && memcmp(_keys[i].name, name, len) == 0) {
+        return &_keys[i];
+      }
+    }
+    if (!create || free == NULL || len >= (long)sizeof(free->name))
+      return NULL;
+    memcpy(free->name, name, len);
+    free->name[len] = 0;
+    return free;
+  }
+
+  // Parse the number ending in \r\n at p, returns where it ends, NULL if it isn't all there.
+
+  static const uint8_t* number(const uint8_t* p, const uint8_t* end, long* n) {
+    const uint8_t* nl = (const uint8_t*)memchr(p, '\n', end - p);
+    if (nl == NULL)
+      return NULL;
+    *n = atol((const char*)p);
+    return nl + 1;
+  }
+
+  void execute(const uint8_t** arg, const long* len, int argc) {
+    char cmd[16];
+    int n = len[0] < (long)sizeof(cmd) ? len[0] : sizeof(cmd) - 1;
+    for (int i = 0; i < n; i++)
+      cmd[i] = arg[0][i] & ~0x20;                             // upper case
+    cmd[n] = 0;
+
+    FakeKey* k = argc > 1 ? key(arg[1], len[1], strcmp(cmd, "DEL") != 0 && strcmp(cmd, "GET") != 0) : NULL;
+    if (strcmp(cmd, "PING") == 0) {
+      reply("+PONG\r\n", 7);
+    } else if (argc > 1 && k == NULL && strcmp(cmd, "GET") == 0) {
+      reply("$-1\r\n", 5);
+    } else if (argc > 1 && k == NULL && strcmp(cmd, "DEL") == 0) {
+      replyInt(0);
+    } else if (k == NULL) {
+      reply("-ERR unknown command or too many keys\r\n", 39);
+    } else if (strcmp(cmd, "SET") == 0 && argc == 3) {
+      k->value = (char*)realloc(k->value, len[2] ? len[2] : 1);
+      memcpy(k->value, arg[2], len[2]);
+      k->len = len[2];
+      reply("+OK\r\n", 5);
+    } else if (strcmp(cmd, "GET") == 0 && argc == 2) {
+      char head[32];
+      reply(head, snprintf(head, sizeof(head), "$%ld\r\n", k->len));
+      reply(k->value, k->len);
+      reply("\r\n", 2);
+    } else if (strcmp(cmd, "INCR") == 0 && argc == 2) {
+      replyInt(++k->number);
+    } else if (strcmp(cmd, "HSET") == 0 && argc >= 4 && argc % 2 == 0) {
+      replyInt((argc - 2) / 2);
+    } else if ((strcmp(cmd, "RPUSH") == 0 || strcmp(cmd, "LPUSH") == 0) && argc >= 3) {
+      k->number += argc - 2;
+      replyInt(k->number);
+    } else if (strcmp(cmd, "DEL") == 0 && argc == 2) {
+      free(k->value);
+      memset(k, 0, sizeof(*k));
+      replyInt(1);
+    } else {
+      reply("-ERR unknown command or wrong number of arguments\r\n", 51);
+    }
+  }
+
+  // Run every complete command in _in, keep the rest for the next write.
+
+  void process() {
+    const uint8_t* p = _in;
+    const uint8_t* end = _in + _inLen;
+    const uint8_t* arg[FAKE_ARGS];
+    long len[FAKE_ARGS];
+
+    while (p < end) {
+      const uint8_t* q = p;
+      long argc;
+      if (*q != '*' || (q = number(q + 1, end, &argc)) == NULL)
+        break;
+      int i = 0;
+      for (; i < argc && q; i++) {
+        long n;
+        if (q >= end || (q = number(q + 1, end, &n)) == NULL || end - q < n + 2) {
+          q = NULL;
+          break;
+        }
+        if (i < FAKE_ARGS) {
+          arg[i] = q;
+          len[i] = n;
+        }
+        q += n + 2;
+      }
+      if (q == NULL)
+        break;                                                // the rest of it is still to come
+      if (argc > FAKE_ARGS)
+        reply("-ERR too many arguments\r\n", 25);
+      else
+        execute(arg, len, argc);
+      p = q;
+    }
+    memmove(_in, p, end - p);
+    _inLen = end - p;
+  }
+
+public:
+  FakeRedis() : _open(false), _in(NULL), _inLen(0), _inSize(0), _out(NULL), _outPos(0), _outLen(0), _outSize(0) {
+    memset(_keys, 0, sizeof(_keys));
+  }
+
+  bool connect(uint32_t, uint16_t) {
+    _open = true;
+    _inLen = 0;
+    _outPos = _outLen = 0;
+    return true;
+  }
+
+  bool connected() {
+    return _open;
+  }
+
+  void close() {
+    _open = false;
+  }
+
+  int write(const uint8_t *buf, uint16_t len) {
+    if (!_open)
+      return -1;
+    grow(&_in, &_inSize, _inLen + len);
+    memcpy(_in + _inLen, buf, len);
+    _inLen += len;
+    process();
+    return len;
+  }
+
+  int available() {
+    long n = _outLen - _outPos;
+    return n > 0x7fff ? 0x7fff : n;
+  }
+
+  int read() {
+    return _outPos < _outLen ? _out[_outPos++] : -1;
+  }
+
+  int read(uint8_t *buf, uint16_t len) {
+    long n = _outLen - _outPos;
+    if (n > len)
+      n = len;
+    memcpy(buf, _out + _outPos, n);
+    _outPos += n;
+    return n;
+  }
+
+  bool waitAvailable(uint32_t) {
+    return available() > 0;                                   // replies are there at once or never
+  }
+};
+
+//
+// The benchmark.
+//
+
+enum BenchCmd { BENCH_SET, BENCH_GET, BENCH_INCR, BENCH_HSET, BENCH_RPUSH };
+
+struct BenchTest {
+  const char* name;
+  BenchCmd cmd;
+  uint16_t args;                                              // fields or items per command
+  uint16_t size;                                              // bytes per value
+  uint16_t depth;                                             // commands per pipeline, 1 for none
+};
+
+static const BenchTest tests[] = {
+  { "SET",   BENCH_SET,   1,   16,   1 },
+  { "SET",   BENCH_SET,   1,  256,   1 },
+  { "SET",   BENCH_SET,   1, 4096,   1 },
+  { "GET",   BENCH_GET,   1,   16,   1 },
+  { "GET",   BENCH_GET,   1,  256,   1 },
+  { "GET",   BENCH_GET,   1, 4096,   1 },
+  { "INCR",  BENCH_INCR,  1,    0,   1 },
+  { "HSET",  BENCH_HSET,  1,   16,   1 },
+  { "HSET",  BENCH_HSET,  8,   16,   1 },
+  { "RPUSH", BENCH_RPUSH, 1,   16,   1 },
+  { "RPUSH", BENCH_RPUSH, 10,  16,   1 },
+  { "RPUSH", BENCH_RPUSH, 100, 16,   1 },
+  { "SET",   BENCH_SET,   1,   16,  16 },
+  { "GET",   BENCH_GET,   1,   16,  16 },
+  { "INCR",  BENCH_INCR,  1,    0,  16 },
+  { "RPUSH", BENCH_RPUSH, 10,  16,  16 },
+  { "SET",   BENCH_SET,   1,   16, 100 },
+  { "GET",   BENCH_GET,   1,   16, 100 },
+  { "INCR",  BENCH_INCR,  1,    0, 100 },
+  { "RPUSH", BENCH_RPUSH, 10,  16, 100 },
+};
+
+static char value[4097];
+static char reply[4097];
+static char* fields[8] = { (char*)"f0", (char*)"f1", (char*)"f2", (char*)"f3",
+                           (char*)"f4", (char*)"f5", (char*)"f6", (char*)"f7" };
+static char* values[8];
+
+static uint64_t nanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int compare(const void* a, const void* b) {
+  uint32_t x = *(const uint32_t*)a;
+  uint32_t y = *(const uint32_t*)b;
+  return x < y ? -1 : x > y;
+}
+
+static void command(RedisClient& redis, const BenchTest* t) {
+  switch (t->cmd) {
+  case BENCH_SET:
+    redis.SET((char*)"bench:key", value);
+    break;
+  case BENCH_GET:
+    redis.GET((char*)"bench:key", reply, sizeof(reply));
+    break;
+  case BENCH_INCR:
+    redis.INCR((char*)"bench:counter");
+    break;
+  case BENCH_HSET:
+    if (t->args == 1)
+      redis.HSET((char*)"bench:hash", fields[0], value);
+    else
+      redis.HSET((char*)"bench:hash", fields, values, t->args);
+    break;
+  case BENCH_RPUSH:
+    redis.startRPUSH((char*)"bench:list", t->args);
+    for (uint16_t i = 0; i < t->args; i++)
+      redis.addArg(value);
+    redis.endPUSH();
+    break;
+  }
+}
+
+// Run t n times (n / depth pipelines), returns false if the connection failed.
+
+static bool run(RedisClient& redis, const BenchTest* t, long n, const char* target, bool json) {
+  long rounds = n / t->depth > 0 ? n / t->depth : 1;
+  uint32_t* ns = (uint32_t*)malloc(rounds * sizeof(uint32_t));
+
+  memset(value, 'x', t->size);
+  value[t->size] = 0;
+  redis.DEL((char*)"bench:list");
+  if (t->cmd == BENCH_GET)
+    redis.SET((char*)"bench:key", value);
+
+  uint64_t start = nanos();
+  for (long r = 0; r < rounds; r++) {
+    uint64_t t0 = nanos();
+    if (t->depth > 1) {
+      redis.beginPipeline();
+      for (uint16_t i = 0; i < t->depth; i++)
+        command(redis, t);
+      redis.execPipeline(NULL, 0);
+    } else {
+      command(redis, t);
+    }
+    ns[r] = nanos() - t0;
+  }
+  uint64_t total = nanos() - start;
+
+  if (!redis.connected()) {
+    free(ns);
+    return false;
+  }
+
+  qsort(ns, rounds, sizeof(uint32_t), compare);
+  double ops = (double)rounds * t->depth * 1e9 / total;
+  double p50 = ns[rounds * 50 / 100] / 1000.0;
+  double p99 = ns[rounds * 99 / 100] / 1000.0;
+  double p999 = ns[rounds * 999 / 1000] / 1000.0;
+  double max = ns[rounds - 1] / 1000.0;
+
+  if (json) {
+    printf("{\"target\":\"%s\",\"test\":\"%s\",\"args\":%u,\"size\":%u,\"pipeline\":%u,\"ops\":%ld,"
+           "\"ops_per_sec\":%.0f,\"p50_us\":%.2f,\"p99_us\":%.2f,\"p999_us\":%.2f,\"max_us\":%.2f,"
+           "\"cmd_buf\":%d,\"rx_buf\":%d}\n", target, t->name, t->args, t->size, t->depth,
+           rounds * t->depth, ops, p50, p99, p999, max, REDIS_CMD_BUF_SIZE, REDIS_RX_BUF_SIZE);
+  } else {
+    printf("%-6s %4u %5u %4u %10.0f %9.2f %9.2f %9.2f %9.2f\n", t->name, t->args, t->size,
+           t->depth, ops, p50, p99, p999, max);
+  }
+  free(ns);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  bool json = false;
+  long n = 20000;
+  const char* host = NULL;
+  uint16_t port = 6379;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-j") == 0)
+      json = true;
+    else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+      n = atol(argv[++i]);
+    else if (host == NULL)
+      host = argv[i];
+    else
+      port = atoi(argv[i]);
+  }
+  for (int i = 0; i < 8; i++)
+    values[i] = value;
+
+  FakeRedis fake;
+  RedisPosixTransport posix;
+  RedisClient redis(host ? RedisPosixTransport::resolve(host) : 0, port,
+                    host ? (RedisTransport*)&posix : (RedisTransport*)&fake);
+  const char* target = host ? host : "fake";
+  if (!redis.connect()) {
+    printf("Can't connect to %s:%d\n", host, port);
+    return 1;
+  }
+
+  if (!json) {
+    printf("%s, %ld ops per test, command buffer %d bytes, receive buffer %d bytes\n", target, n,
+           REDIS_CMD_BUF_SIZE, REDIS_RX_BUF_SIZE);
+    printf("latency is per round trip (per pipeline), in microseconds\n\n");
+    printf("test   args  size pipe      ops/s       p50       p99      p999       max\n");
+  }
+  for (unsigned i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+    if (!run(redis, &tests[i], n, target, json)) {
+      printf("%s: the connection failed\n", tests[i].name);
+      return 1;
+    }
+  }
+
+  redis.DEL((char*)"bench:key");
+  redis.DEL((char*)"bench:counter");
+  redis.DEL((char*)"bench:hash");
+  redis.DEL((char*)"bench:list");
+  redis.disconnect();
+  return 0;
+}
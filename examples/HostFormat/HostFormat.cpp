@@ -0,0 +1,126 @@
+//
+// Host (Linux/macOS) benchmark of the number formatters in RedisFormat against snprintf, no
+// REDIS server needed. Each line times one formatter over the same n random values:
+//
+//   INT32    redisFormatInt64 / %ld on values that fit 32 bits (counters, INCRBY amounts)
+//   INT64    redisFormatInt64 / %lld on full range 64 bit values
+//   DOUBLE   redisFormatDouble / %.17g, which always round trips but is rarely the shortest
+//   SHORTEST redisFormatDouble / the fewest %.<p>g digits that read back the same, the text
+//            redisFormatDouble produces, found by trying p = 1..17 like Python's repr used to
+//
+// Every value formatted by RedisFormat is read back with strtoll/strtod and must come back
+// unchanged; the benchmark fails otherwise.
+//
+// Build from the library folder:
+//
+//   g++ -O2 -I. RedisFormat.cpp examples/HostFormat/HostFormat.cpp -o hostformat
+//   ./hostformat [iterations]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "RedisFormat.h"
+
+static uint64_t seed = 88172645463325252ULL;
+
+// xorshift64, the same values on every run and every machine.
+
+static uint64_t random64() {
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return seed;
+}
+
+static volatile uint32_t sink;                                // keeps the compiler from dropping the work
+
+static void report(const char* name, unsigned long ours_us, unsigned long theirs_us, long n) {
+  printf("%-8s %8ld values  %7.1f ns  snprintf %7.1f ns  %5.1fx\n", name, n,
+         ours_us * 1000.0 / n, theirs_us * 1000.0 / n, (double)theirs_us / ours_us);
+}
+
+static int shortest(char* buf, double d) {
+  int len = 0;
+  for (int p = 1; p <= 17; p++) {
+    len = snprintf(buf, 32, "%.*g", p, d);
+    if (strtod(buf, NULL) == d)
+      break;
+  }
+  return len;
+}
+
+int main(int argc, char** argv) {
+  long n = argc > 1 ? atol(argv[1]) : 1000000;
+  int64_t* ints = new int64_t[n];
+  double* doubles = new double[n];
+  char buf[32];
+  long bad = 0;
+
+  for (long i = 0; i < n; i++) {
+    uint64_t bits = random64();
+    memcpy(&doubles[i], &bits, sizeof(bits));
+    if (doubles[i] != doubles[i] || doubles[i] - doubles[i] != 0)
+      doubles[i] = (double)(int64_t)bits / 1e6;               // no nan or inf
+    if (i % 2)
+      doubles[i] = (double)(random64() % 100000) / 100;       // prices, temperatures
+  }
+
+  for (long i = 0; i < n; i++)
+    ints[i] = (int32_t)random64();
+  unsigned long time = micros();
+  for (long i = 0; i < n; i++)
+    sink += redisFormatInt64(ints[i], buf);
+  unsigned long ours = micros() - time;
+  time = micros();
+  for (long i = 0; i < n; i++)
+    sink += snprintf(buf, sizeof(buf), "%ld", (long)ints[i]);
+  report("INT32", ours, micros() - time, n);
+  for (long i = 0; i < n; i++) {
+    redisFormatInt64(ints[i], buf);
+    bad += strtoll(buf, NULL, 10) != ints[i];
+  }
+
+  for (long i = 0; i < n; i++)
+    ints[i] = (int64_t)random64();
+  time = micros();
+  for (long i = 0; i < n; i++)
+    sink += redisFormatInt64(ints[i], buf);
+  ours = micros() - time;
+  time = micros();
+  for (long i = 0; i < n; i++)
+    sink += snprintf(buf, sizeof(buf), "%lld", (long long)ints[i]);
+  report("INT64", ours, micros() - time, n);
+  for (long i = 0; i < n; i++) {
+    redisFormatInt64(ints[i], buf);
+    bad += strtoll(buf, NULL, 10) != ints[i];
+  }
+
+  time = micros();
+  for (long i = 0; i < n; i++)
+    sink += redisFormatDouble(doubles[i], buf);
+  ours = micros() - time;
+  time = micros();
+  for (long i = 0; i < n; i++)
+    sink += snprintf(buf, sizeof(buf), "%.17g", doubles[i]);
+  report("DOUBLE", ours, micros() - time, n);
+
+  time = micros();
+  for (long i = 0; i < n; i++)
+    sink += shortest(buf, doubles[i]);
+  report("SHORTEST", ours, micros() - time, n);
+
+  long longer = 0;
+  for (long i = 0; i < n; i++) {
+    char ref[32];
+    int len = redisFormatDouble(doubles[i], buf);
+    bad += strtod(buf, NULL) != doubles[i];
+    longer += len > shortest(ref, doubles[i]);
+  }
+
+  printf("round trip failures %ld, longer than the shortest %ld (%.3f%%)\n", bad, longer, longer * 100.0 / n);
+  delete[] ints;
+  delete[] doubles;
+  return bad != 0;
+}
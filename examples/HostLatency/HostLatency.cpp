@@ -0,0 +1,115 @@
+//
+// Host (Linux/macOS) example: measure the round trip latency of GET, INCR and RPUSH against a
+// REDIS server, using the same RedisClient code that runs on the Arduino. SET1K (a 1000 byte
+// value) and PIPE100 (100 pipelined INCRs) show what the command buffer size costs: build it
+// with a few -DREDIS_CMD_BUF_SIZE=... values and compare the writes per operation.
+//
+// Build from the library folder:
+//
+//   g++ -O2 -I. RedisClient.cpp RedisParser.cpp RedisFormat.cpp RedisSha1.cpp RedisPosixTransport.cpp examples/HostLatency/HostLatency.cpp -o hostlatency
+//   ./hostlatency [host] [port] [iterations]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "RedisClient.h"
+
+// Counts the writes, each one is a send() here and a packet over the air on the CC3000.
+
+class CountingTransport : public RedisPosixTransport {
+public:
+  long writes;
+
+  CountingTransport() : writes(0) {}
+
+  int write(const uint8_t *buf, uint16_t len) {
+    writes++;
+    return RedisPosixTransport::write(buf, len);
+  }
+};
+
+static CountingTransport transport;
+
+static void report(const char* name, unsigned long total_us, long n, long writes) {
+  printf("%-7s %8ld ops  %10.1f us/op  %10.0f ops/s  %6.1f writes/op\n", name, n,
+         (double)total_us / n, n * 1000000.0 / total_us, (double)writes / n);
+}
+
+int main(int argc, char** argv) {
+  const char* host = argc > 1 ? argv[1] : "127.0.0.1";
+  uint16_t port = argc > 2 ? atoi(argv[2]) : 6379;
+  long n = argc > 3 ? atol(argv[3]) : 10000;
+  char buffer[32];
+  char value[1001];
+  long writes;
+
+  // The commands take char*, so the keys are arrays rather than string literals.
+  char key[] = "hostlatency:key";
+  char counter[] = "hostlatency:counter";
+  char list[] = "hostlatency:list";
+  char big[] = "hostlatency:big";
+  char hello[] = "hello bye";
+
+  memset(value, 'x', sizeof(value) - 1);
+  value[sizeof(value) - 1] = 0;
+
+  RedisClient redis(RedisPosixTransport::resolve(host), port, &transport);
+  if (!redis.connect()) {
+    printf("Can't connect to %s:%d\n", host, port);
+    return 1;
+  }
+  printf("command buffer %d bytes, receive buffer %d bytes\n", REDIS_CMD_BUF_SIZE, REDIS_RX_BUF_SIZE);
+
+  redis.DEL(counter);
+  redis.DEL(list);
+  redis.SET(key, hello);
+
+  unsigned long time = micros();
+  writes = transport.writes;
+  for (long i = 0; i < n; i++)
+    redis.GET(key, buffer, sizeof(buffer) - 1);
+  report("GET", micros() - time, n, transport.writes - writes);
+
+  time = micros();
+  writes = transport.writes;
+  for (long i = 0; i < n; i++)
+    redis.INCR(counter);
+  report("INCR", micros() - time, n, transport.writes - writes);
+
+  time = micros();
+  writes = transport.writes;
+  for (long i = 0; i < n; i++) {
+    redis.startRPUSH(list, 6);
+    redis.addArg("1");
+    redis.addArg("2");
+    redis.addArg("3");
+    redis.addArg("4");
+    redis.addArg("5");
+    redis.addArg("6");
+    redis.endPUSH();
+  }
+  report("RPUSH", micros() - time, n, transport.writes - writes);
+
+  time = micros();
+  writes = transport.writes;
+  for (long i = 0; i < n; i++)
+    redis.SET(big, value);
+  report("SET1K", micros() - time, n, transport.writes - writes);
+
+  time = micros();
+  writes = transport.writes;
+  for (long i = 0; i < n; i++) {
+    redis.beginPipeline();
+    for (int k = 0; k < 100; k++)
+      redis.INCR(counter);
+    redis.execPipeline(NULL, 0);
+  }
+  report("PIPE100", micros() - time, n, transport.writes - writes);
+
+  redis.DEL(list);
+  redis.DEL(big);
+  redis.disconnect();
+  return 0;
+}
@@ -0,0 +1,482 @@
+//
+// Host (Linux/macOS) fuzz test and benchmark of RedisParser, no REDIS server needed.
+//
+// Random RESP2 and RESP3 replies (nested arrays, maps, sets, pushes, attributes, binary bulk
+// strings of up to 3000 bytes...) are written together with the elements the parser must hand
+// out for them. The text is then fed to the parser the way RedisClient does it: a receive buffer
+// of window bytes, filled by reads of random size, 1 byte at times, and compacted after every
+// parse() call. Bulk strings bigger than the window arrive in pieces; the pieces are put back
+// together and every element must match; status and error lines longer than the window are cut
+// to it. Each element is also copied into a small buffer with redisCopyElement(), which must
+// keep to the buffer: guard bytes behind it are checked.
+//
+// redisParseIP() is checked on a few good and bad addresses as well.
+//
+// The benchmark then parses typical replies (bulk strings, integers, MGET style arrays) from
+// a 4096 byte window.
+//
+// Build from the library folder:
+//
+//   g++ -O2 -I. RedisParser.cpp examples/HostParser/HostParser.cpp -o hostparser
+//   ./hostparser [batches]
+//
+// Prints the first difference and exits with 1 if anything is wrong.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "RedisParser.h"
+
+#define MAX_TEXT (4 << 20)                                    // RESP text of one batch
+#define MAX_ELEMENTS 200000                                   // elements of one batch
+#define GUARD 8192                                            // guard bytes behind a copy buffer
+
+// One element, as expected or as received. Its text is at data[0..len) in a pool.
+
+struct Element {
+  RedisResult type;
+  uint8_t depth;
+  uint16_t index;
+  int64_t integer;
+  long data;                                                  // offset of the text in the pool
+  long len;                                                   // length of the text
+};
+
+static char text[MAX_TEXT];                                   // the replies
+static long textLen;
+static Element expected[MAX_ELEMENTS];
+static long expectedCount;
+static char expectedPool[MAX_TEXT];
+static long expectedPoolLen;
+static Element received[MAX_ELEMENTS];
+static long receivedCount;
+static char receivedPool[MAX_TEXT];
+static long receivedPoolLen;
+static bool failed;
+static uint16_t window;                                       // receive buffer size of the batch
+
+static uint64_t seed = 88172645463325252ULL;
+
+// xorshift64, the same values on every run and every machine.
+
+static uint64_t random64() {
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return seed;
+}
+
+static uint32_t randomBelow(uint32_t n) {
+  return random64() % n;
+}
+
+static void put(const char* data, long len) {
+  memcpy(text + textLen, data, len);
+  textLen += len;
+}
+
+static void putf(const char* format, long long value) {
+  textLen += sprintf(text + textLen, format, value);
+}
+
+static void expect(RedisResult type, uint8_t depth, uint16_t index, int64_t integer, const char* data, long len) {
+  Element* e = &expected[expectedCount++];
+  e->type = type;
+  e->depth = depth;
+  e->index = index;
+  e->integer = integer;
+  e->data = expectedPoolLen;
+  e->len = len;
+  if (len > 0)
+    memcpy(expectedPool + expectedPoolLen, data, len);
+  expectedPoolLen += len;
+}
+
+// A line of printable text, no \r or \n.
+
+static long randomLine(char* buf, long max) {
+  long len = randomBelow(max + 1);
+  for (long i = 0; i < len; i++)
+    buf[i] = ' ' + randomBelow(95);
+  return len;
+}
+
+static long randomLength() {
+  switch (randomBelow(4)) {
+  case 0:  return randomBelow(8);
+  case 1:  return randomBelow(100);
+  case 2:  return randomBelow(400);
+  default: return randomBelow(3000);
+  }
+}
+
+// Write one random element at depth with position index, and what the parser must make of it.
+
+static void generate(uint8_t depth, uint16_t index) {
+  char buf[3100];
+  long len;
+
+  if (depth < 6 && randomBelow(20) == 0)
+    put("|1\r\n+key\r\n:1\r\n", 14);                          // an attribute, skipped
+
+  uint8_t kind = randomBelow(depth < 4 ? 17 : 13);
+  switch (kind) {
+  case 0:
+  case 1:
+    len = randomLine(buf, randomBelow(8) ? 40 : 300);
+    put(kind == 0 ? "+" : "-", 1);
+    put(buf, len);
+    put("\r\n", 2);
+    if (len > window - 1)
+      len = window - 1;                                       // what fits next to the prefix
+    expect(kind == 0 ? RedisResult_SINGLELINE : RedisResult_ERROR, depth, index, len, buf, len);
+    break;
+
+  case 2: {
+    int64_t n = (int64_t)random64() >> randomBelow(64);
+    len = sprintf(buf, "%lld", (long long)n);
+    put(":", 1);
+    put(buf, len);
+    put("\r\n", 2);
+    expect(RedisResult_INTEGER, depth, index, n, buf, len);
+    break;
+  }
+
+  case 3:
+  case 4:
+  case 5:
+    len = randomLength();
+    for (long i = 0; i < len; i++)
+      buf[i] = random64();                                    // binary, \r\n and \0 included
+    putf("$%lld\r\n", len);
+    put(buf, len);
+    put("\r\n", 2);
+    expect(RedisResult_BULK, depth, index, len, buf, len);
+    break;
+
+  case 6:
+    put("$-1\r\n", 5);
+    expect(RedisResult_BULK, depth, index, -1, NULL, 0);
+    break;
+
+  case 7:
+    put("_\r\n", 3);
+    expect(RedisResult_NULL, depth, index, -1, NULL, 0);
+    break;
+
+  case 8:
+    len = sprintf(buf, randomBelow(8) ? "%.17g" : "%.0f", ((int64_t)random64() >> 20) / 1024.0);
+    put(",", 1);
+    put(buf, len);
+    put("\r\n", 2);
+    expect(RedisResult_DOUBLE, depth, index, len, buf, len);
+    break;
+
+  case 9:
+    buf[0] = randomBelow(2) ? 't' : 'f';
+    put("#", 1);
+    put(buf, 1);
+    put("\r\n", 2);
+    expect(RedisResult_BOOLEAN, depth, index, buf[0] == 't', buf, 1);
+    break;
+
+  case 10:
+    len = 1 + randomBelow(40);
+    for (long i = 0; i < len; i++)
+      buf[i] = '0' + randomBelow(10);
+    put("(", 1);
+    put(buf, len);
+    put("\r\n", 2);
+    expect(RedisResult_BIGNUMBER, depth, index, len, buf, len);
+    break;
+
+  case 11:
+    len = randomLength();
+    for (long i = 0; i < len; i++)
+      buf[i] = random64();
+    putf("=%lld\r\ntxt:", len + 4);
+    put(buf, len);
+    put("\r\n", 2);
+    expect(RedisResult_VERBATIM, depth, index, len, buf, len);
+    break;
+
+  case 12:
+    len = randomLength();
+    for (long i = 0; i < len; i++)
+      buf[i] = random64();
+    putf("!%lld\r\n", len);
+    put(buf, len);
+    put("\r\n", 2);
+    expect(RedisResult_ERROR, depth, index, len, buf, len);
+    break;
+
+  default: {
+    // Aggregates, only above depth 4.
+    static const char prefixes[] = "*%~>";
+    static const RedisResult types[] = {RedisResult_MULTIBULK, RedisResult_MAP, RedisResult_SET, RedisResult_PUSH};
+    uint8_t k = kind - 13;
+    long n = randomBelow(6);
+    if (k == 0 && randomBelow(10) == 0)
+      n = -1;
+    textLen += sprintf(text + textLen, "%c%ld\r\n", prefixes[k], n);
+    expect(types[k], depth, index, n, NULL, 0);
+    for (long i = 0; i < (k == 1 ? 2 * n : n); i++)
+      generate(depth + 1, i);
+    break;
+  }
+  }
+}
+
+// The element being received and the copy of it redisCopyElement() makes.
+
+static char* copyBuf;
+static uint16_t copySize;
+
+static void checkCopy() {
+  if (receivedCount == 0 || failed)
+    return;
+
+  Element* e = &received[receivedCount - 1];
+  long keep = e->len < copySize - 1 ? e->len : copySize - 1;
+  if (memcmp(copyBuf, receivedPool + e->data, keep) != 0 || copyBuf[keep] != 0) {
+    printf("FAIL: element %ld copied wrong into %u bytes\n", receivedCount - 1, copySize);
+    failed = true;
+  }
+  for (long i = copySize; i < copySize + GUARD; i++) {
+    if ((uint8_t)copyBuf[i] != 0xaa) {
+      printf("FAIL: element %ld (%ld bytes) copied into %u bytes wrote guard byte %ld\n",
+             receivedCount - 1, e->len, copySize, i);
+      failed = true;
+      break;
+    }
+  }
+}
+
+static void collect(void*, const RedisElement* e) {
+  Element* last = receivedCount ? &received[receivedCount - 1] : NULL;
+
+  if (e->offset > 0) {
+    // The next piece of a bulk string.
+    if (last == NULL || last->depth != e->depth || last->index != e->index || last->len != e->offset) {
+      if (!failed)
+        printf("FAIL: piece at offset %ld doesn't continue element %ld\n", e->offset, receivedCount - 1);
+      failed = true;
+      return;
+    }
+  } else {
+    checkCopy();
+    if (receivedCount == MAX_ELEMENTS)
+      return;
+    last = &received[receivedCount++];
+    last->type = e->type;
+    last->depth = e->depth;
+    last->index = e->index;
+    last->integer = e->integer;
+    last->data = receivedPoolLen;
+    last->len = 0;
+    copySize = 1 + randomBelow(24);
+    memset(copyBuf, 0xaa, copySize + GUARD);
+  }
+  if (e->len > 0)
+    memcpy(receivedPool + receivedPoolLen, e->data, e->len);
+  receivedPoolLen += e->len;
+  last->len += e->len;
+  redisCopyElement(copyBuf, copySize, e);
+}
+
+// Feed text to the parser through a receive buffer of window bytes, in reads of random size.
+// Returns the number of replies parsed.
+
+static long feed(RedisParser* parser, long replies, bool oneByte) {
+  uint8_t* rx = new uint8_t[window];
+  uint16_t rxLen = 0;
+  long pos = 0;
+  long done = 0;
+
+  parser->reset();
+  while (done < replies) {
+    uint16_t used;
+    RedisParser::Status status = parser->parse(rx, rxLen, &used);
+    memmove(rx, rx + used, rxLen - used);
+    rxLen -= used;
+    if (status == RedisParser::PARSE_DONE) {
+      checkCopy();
+      done++;
+      parser->reset();
+      continue;
+    }
+    if (status == RedisParser::PARSE_ERROR || pos == textLen || rxLen == window) {
+      printf("FAIL: reply %ld, %s at byte %ld of %ld, window %u\n", done,
+             status == RedisParser::PARSE_ERROR ? "parse error" : "stuck", pos, textLen, window);
+      failed = true;
+      break;
+    }
+    long n = oneByte ? 1 : 1 + randomBelow(window - rxLen);
+    if (n > textLen - pos)
+      n = textLen - pos;
+    memcpy(rx + rxLen, text + pos, n);
+    rxLen += n;
+    pos += n;
+  }
+  delete[] rx;
+  return done;
+}
+
+static bool compare() {
+  if (failed)
+    return false;
+  if (receivedCount != expectedCount) {
+    printf("FAIL: %ld elements, expected %ld\n", receivedCount, expectedCount);
+    return false;
+  }
+  for (long i = 0; i < expectedCount; i++) {
+    Element* a = &expected[i];
+    Element* b = &received[i];
+    if (a->type != b->type || a->depth != b->depth || a->index != b->index || a->integer != b->integer ||
+        a->len != b->len || memcmp(expectedPool + a->data, receivedPool + b->data, a->len) != 0) {
+      printf("FAIL: element %ld: type %d/%d depth %u/%u index %u/%u integer %lld/%lld len %ld/%ld\n", i,
+             a->type, b->type, a->depth, b->depth, a->index, b->index,
+             (long long)a->integer, (long long)b->integer, a->len, b->len);
+      return false;
+    }
+  }
+  return true;
+}
+
+// A 200 byte error line in an array, through a 128 byte window as on an Arduino: the error
+// is cut to 127 bytes and the integer after it is still read.
+
+static bool longErrorLine(RedisParser* parser, bool oneByte) {
+  char line[200];
+
+  memcpy(line, "ERR ", 4);
+  for (int i = 4; i < 200; i++)
+    line[i] = 'a' + i % 26;
+  textLen = 0;
+  expectedCount = 0;
+  expectedPoolLen = 0;
+  put("*2\r\n-", 5);
+  put(line, 200);
+  put("\r\n:5\r\n", 6);
+  expect(RedisResult_MULTIBULK, 0, 0, 2, NULL, 0);
+  expect(RedisResult_ERROR, 1, 0, 127, line, 127);
+  expect(RedisResult_INTEGER, 1, 1, 5, "5", 1);
+
+  window = 128;
+  receivedCount = 0;
+  receivedPoolLen = 0;
+  parser->setWindow(window);
+  if (feed(parser, 1, oneByte) != 1 || !compare()) {
+    printf("long error line%s\n", oneByte ? ", 1 byte reads" : "");
+    return false;
+  }
+  return true;
+}
+
+// Addresses as they come in CLUSTER SLOTS and MOVED, and ones that must be refused.
+
+static bool parseIPs() {
+  static const struct {
+    const char* text;
+    bool ok;
+    uint32_t ip;
+  } cases[] = {
+    {"127.0.0.1", true, 0x7f000001},
+    {"10.0.255.254", true, 0x0a00fffe},
+    {"0.0.0.0", true, 0},
+    {"255.255.255.255", true, 0xffffffff},
+    {"300.1.1.1", false, 0},
+    {"1.256.1.1", false, 0},
+    {"1.1.1.256", false, 0},
+    {"1.1.1", false, 0},
+    {"1.1.1.1.1", false, 0},
+    {"1..1.1", false, 0},
+    {"1.1.1.", false, 0},
+    {"", false, 0},
+    {"::1", false, 0},
+  };
+
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    uint32_t ip = 0;
+    bool ok = redisParseIP(cases[i].text, strlen(cases[i].text), &ip);
+    if (ok != cases[i].ok || (ok && ip != cases[i].ip)) {
+      printf("FAIL: redisParseIP(\"%s\") %s %08x\n", cases[i].text, ok ? "accepted" : "refused", ip);
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  long batches = argc > 1 ? atol(argv[1]) : 500;
+  static const uint16_t windows[] = {64, 100, 128, 256, 1024, 4096};
+  RedisParser parser;
+  long replies = 0;
+  long elements = 0;
+
+  copyBuf = new char[32 + GUARD];
+  parser.setHandler(collect, NULL);
+  if (!longErrorLine(&parser, true) || !longErrorLine(&parser, false) || !parseIPs())
+    return 1;
+
+  for (long b = 0; b < batches; b++) {
+    long n = 1 + randomBelow(40);
+    window = windows[randomBelow(sizeof(windows) / sizeof(windows[0]))];
+    textLen = 0;
+    expectedCount = 0;
+    expectedPoolLen = 0;
+    for (long i = 0; i < n; i++)
+      generate(0, 0);
+
+    receivedCount = 0;
+    receivedPoolLen = 0;
+    parser.setWindow(window);
+    if (feed(&parser, n, b % 10 == 0) != n || !compare()) {
+      printf("batch %ld: %ld replies, %ld bytes, window %u\n", b, n, textLen, window);
+      return 1;
+    }
+    replies += n;
+    elements += expectedCount;
+  }
+  printf("fuzz ok: %ld replies, %ld elements in %ld batches\n", replies, elements, batches);
+
+  // Throughput: GET, INCR and MGET replies back to back, read in full windows.
+  textLen = 0;
+  long n = 0;
+  while (textLen < MAX_TEXT - 4096) {
+    put("$100\r\n", 6);
+    for (int i = 0; i < 100; i++)
+      put("x", 1);
+    static const char rest[] = "\r\n:12345\r\n*4\r\n$5\r\nhello\r\n$-1\r\n$3\r\nabc\r\n$8\r\n12345678\r\n";
+    put(rest, sizeof(rest) - 1);
+    n += 3;
+  }
+  parser.setHandler(NULL, NULL);
+  parser.setWindow(4096);
+  uint8_t* rx = new uint8_t[4096];
+  uint16_t rxLen = 0;
+  long pos = 0;
+  unsigned long start = micros();
+  for (long done = 0; done < n; ) {
+    uint16_t used;
+    RedisParser::Status status = parser.parse(rx, rxLen, &used);
+    memmove(rx, rx + used, rxLen - used);
+    rxLen -= used;
+    if (status == RedisParser::PARSE_DONE) {
+      done++;
+      parser.reset();
+    } else {
+      long take = textLen - pos < 4096 - rxLen ? textLen - pos : 4096 - rxLen;
+      memcpy(rx + rxLen, text + pos, take);
+      rxLen += take;
+      pos += take;
+    }
+  }
+  unsigned long us = micros() - start;
+  delete[] rx;
+  printf("%ld replies in %lu us: %.1f MB/s, %.0f ns per reply\n", n, us, textLen / (double)us,
+         us * 1000.0 / n);
+  return 0;
+}
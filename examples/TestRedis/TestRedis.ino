@@ -32,6 +32,17 @@ uint32_t ip;                       // the IP address
 RedisClient* redis;
 #define LED  8                       // we will blink an LED on pin 8.
 
+// Told when the connection to REDIS comes up, goes down, or a connect attempt fails.
+void onConnection(void* ctx, RedisConnectionState state, uint32_t retry_ms) {
+  if (state == RedisConnection_UP) {
+    Serial.println(F("REDIS UP"));
+  } else if (state == RedisConnection_DOWN) {
+    Serial.println(F("REDIS DOWN"));
+  } else {
+    Serial.print(F("REDIS RETRY IN ")); Serial.println(retry_ms);
+  }
+}
+
 void setup() {
   Serial.begin(19200);
   pinMode(LED,OUTPUT);
@@ -80,6 +91,8 @@ void setup() {
 
   Serial.println("HERE WE GO");
   redis = new RedisClient(ip,6379, &cc3000);
+  redis->onConnection(onConnection, NULL);
+  redis->setKeepAlive(5000);         // find a dead WiFi link while the loop below sleeps
 
 }
 
@@ -175,6 +188,18 @@ void loop() {
     while(1);
   }
 
+  RedisReply replies[3];
+  redis->beginPipeline();
+  redis->INCR("test");
+  redis->INCR("test");
+  redis->INCR("test");
+  redis->execPipeline(replies, 3);
+  if (replies[2].type != RedisResult_INTEGER || replies[2].integer != replies[0].integer + 2) {
+    Serial.println("PIPELINE FAILED");
+    while(1);
+  }
+  Serial.println("PIPELINE PASSED");
+
   i = redis->LTRIM("list",1,3);
   Serial.print("TRIM: "); Serial.println(i);
   int mode = 0;
@@ -189,12 +214,11 @@ void loop() {
       digitalWrite(LED,LOW);
     }
     mode = !mode;
-    if (i % 300 == 0) {
-      Serial.println("STOPPING");
-      redis->disconnect();
-      redis->connect();
-      Serial.println("RESTARTED");
-    }
+    redis->poll();                   // reconnects and keeps the connection alive
+#if REDIS_STATS
+    if (i % 60 == 0)
+      redis->printStats(Serial);     // latency per command, bytes, reconnects, errors
+#endif
     delay(1000);
   }
 